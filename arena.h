@@ -0,0 +1,298 @@
+/**
+ *  bump allocator for per-thread scratch memory
+ *
+ * 	example:
+ * 		minify::type::arena pool;
+ * 		minify::type::string code(pool);
+ * 		code.load_file("file-path");
+ * 		..
+ * 		code.drop();
+ * 		pool.reset();
+ *
+ *  allocations are carved out of one contiguous block, anything that
+ *  does not fit goes to an overflow list. whenever the arena is emptied
+ *  the block is regrown to the peak usage seen so far, so a thread that
+ *  is reset between files stops calling malloc after the first few
+ */
+
+#ifndef MINIFY_ARENA_H
+#define MINIFY_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <string.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <new>
+
+namespace minify {
+	namespace type {
+		class arena {
+			static constexpr std::size_t ALIGNMENT = 16;
+			static constexpr std::size_t MIN_BLOCK = 1 << 16;
+
+			struct alignas(ALIGNMENT) overflow {
+				overflow* prev;
+				std::size_t size;
+			};
+
+			char* block_ = nullptr;
+			std::size_t capacity_  = 0,
+			            used_      = 0,
+			            in_use_    = 0,
+			            peak_      = 0,
+			            overflows_ = 0;
+			overflow* overflow_ = nullptr;
+			//where the latest mark was taken, what is below it stays as it is until the rewind
+			std::size_t floor_used_      = 0,
+			            floor_overflows_ = 0;
+
+			static std::size_t aligned(std::size_t const& size) {
+				return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			}
+
+			static char* data(overflow* o) {
+				return (char*) (o + 1);
+			}
+
+			bool is_top(
+				void* ptr,
+				std::size_t const& size
+			) const {
+				return (
+					ptr &&
+					(char*) ptr >= block_ + floor_used_ &&
+					(char*) ptr + aligned(size) == block_ + used_
+				);
+			}
+
+			bool is_last_overflow(void* ptr) const {
+				return (
+					overflows_ > floor_overflows_ &&
+					ptr == data(overflow_)
+				);
+			}
+
+			void regrow() {
+				if(peak_ > capacity_) {
+					free(block_);
+					capacity_ = aligned(std::max(peak_, std::size_t(MIN_BLOCK)));
+					block_ = (char*) malloc(capacity_);
+					if(!block_)
+						throw std::bad_alloc();
+				}
+			}
+
+			public:
+			struct marker {
+				std::size_t used, in_use, overflows;
+				std::size_t floor_used, floor_overflows;
+			};
+
+			arena() {
+			}
+
+			arena(arena const&) = delete;
+			arena& operator=(arena const&) = delete;
+
+			~arena() {
+				reset();
+				free(block_);
+			}
+
+			void* allocate(std::size_t const& size) {
+				std::size_t const length = aligned(std::max<std::size_t>(size, 1));
+
+				in_use_ += length;
+				peak_ = std::max(peak_, in_use_);
+
+				if(!capacity_ && !overflow_)
+					regrow();
+
+				if(used_ + length <= capacity_) {
+					used_ += length;
+					return block_ + used_ - length;
+				}
+
+				overflow* o = (overflow*) malloc(sizeof(overflow) + length);
+				if(!o)
+					throw std::bad_alloc();
+				o->prev = overflow_;
+				o->size = length;
+				overflow_ = o;
+				++overflows_;
+
+				return data(o);
+			}
+
+			void* reallocate(
+				void* ptr,
+				std::size_t const& size,
+				std::size_t const& new_size
+			) {
+				if(!ptr)
+					return allocate(new_size);
+
+				assert(!((char*) ptr >= block_ && (char*) ptr < block_ + floor_used_));
+
+				std::size_t const length     = aligned(std::max<std::size_t>(size, 1)),
+				                  new_length = aligned(std::max<std::size_t>(new_size, 1));
+
+				if(is_top(ptr, size) && used_ - length + new_length <= capacity_) {
+					used_ = used_ - length + new_length;
+					in_use_ = in_use_ - length + new_length;
+					peak_ = std::max(peak_, in_use_);
+					return ptr;
+				}
+				else if(is_last_overflow(ptr)) {
+					overflow* o = (overflow*) realloc(overflow_, sizeof(overflow) + new_length);
+					if(!o)
+						throw std::bad_alloc();
+					o->size = new_length;
+					overflow_ = o;
+					in_use_ = in_use_ - length + new_length;
+					peak_ = std::max(peak_, in_use_);
+					return data(o);
+				}
+
+				void* moved = allocate(new_size);
+				memcpy(moved, ptr, std::min(size, new_size));
+				deallocate(ptr, size);
+
+				return moved;
+			}
+
+			//only the most recent allocation is actually released, if it is newer than the latest mark
+			void deallocate(
+				void* ptr,
+				std::size_t const& size
+			) {
+				std::size_t const length = aligned(std::max<std::size_t>(size, 1));
+
+				if(is_top(ptr, size)) {
+					used_ -= length;
+					in_use_ -= length;
+				}
+				else if(is_last_overflow(ptr)) {
+					overflow* o = overflow_;
+					overflow_ = o->prev;
+					--overflows_;
+					in_use_ -= o->size;
+					free(o);
+				}
+			}
+
+			/*
+			 *  until the rewind to it, allocations made before the mark are
+			 *  neither grown nor released in place, so the rewind never cuts
+			 *  into one. overflow blocks are counted rather than pointed to,
+			 *  realloc may move the one a pointer would name. an allocation
+			 *  from before the mark is not to be grown before the rewind, the
+			 *  memory it would move to goes with the rewind
+			 */
+			marker mark() {
+				marker const m{used_, in_use_, overflows_, floor_used_, floor_overflows_};
+
+				floor_used_ = used_;
+				floor_overflows_ = overflows_;
+
+				return m;
+			}
+
+			//releases everything allocated since m was taken
+			void rewind(marker const& m) {
+				while(overflows_ > m.overflows) {
+					overflow* o = overflow_;
+					overflow_ = o->prev;
+					--overflows_;
+					free(o);
+				}
+				used_ = m.used;
+				in_use_ = m.in_use;
+				floor_used_ = m.floor_used;
+				floor_overflows_ = m.floor_overflows;
+
+				if(!used_ && !overflow_)
+					regrow();
+			}
+
+			void reset() {
+				rewind(marker{0, 0, 0, 0, 0});
+			}
+
+			std::size_t const& capacity() const {
+				return capacity_;
+			}
+
+			std::size_t const& peak() const {
+				return peak_;
+			}
+		};
+
+		//releases a scratch arena back to where it was on scope exit
+		class arena_scope {
+			arena& pool_;
+			arena::marker const marker_;
+
+			public:
+			explicit arena_scope(arena& pool) :
+				pool_(pool),
+				marker_(pool.mark()) {
+			}
+
+			arena_scope(arena_scope const&) = delete;
+			arena_scope& operator=(arena_scope const&) = delete;
+
+			~arena_scope() {
+				pool_.rewind(marker_);
+			}
+		};
+
+		//std allocator adaptor so containers can draw from an arena
+		template <class T>
+		class arena_allocator {
+			template <class U> friend class arena_allocator;
+
+			arena* pool_;
+
+			public:
+			typedef T value_type;
+
+			explicit arena_allocator(arena& pool) :
+				pool_(&pool) {
+			}
+
+			template <class U>
+			arena_allocator(arena_allocator<U> const& other) :
+				pool_(other.pool_) {
+			}
+
+			T* allocate(std::size_t n) {
+				return (T*) pool_->allocate(n*sizeof(T));
+			}
+
+			void deallocate(T* ptr, std::size_t n) {
+				pool_->deallocate(ptr, n*sizeof(T));
+			}
+
+			template <class U>
+			bool operator==(arena_allocator<U> const& other) const {
+				return pool_ == other.pool_;
+			}
+
+			template <class U>
+			bool operator!=(arena_allocator<U> const& other) const {
+				return pool_ != other.pool_;
+			}
+		};
+
+		//per-thread arena for scratch state inside the minifiers
+		inline arena& scratch_arena() {
+			static thread_local arena pool;
+			return pool;
+		}
+	}
+}
+
+#endif //MINIFY_ARENA_H
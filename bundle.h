@@ -0,0 +1,273 @@
+/**
+ *  writes the minified inputs of a bundle (-o, or the terminal) straight
+ *  to their place in the output as they finish
+ *
+ *  each input has a slot. a worker publishes the minified length of its
+ *  input, and the offset of the input after it is the running sum of the
+ *  lengths so far. whoever fills in the last missing piece of a slot
+ *  (its length or its offset) writes it and only then carries the sum on
+ *  to the next slot, so there is no lock, no two writes overlap and the
+ *  output goes out while later inputs still minify. an input that
+ *  finishes before everything in front of it keeps its buffer in the
+ *  slot until its offset is known
+ *
+ *  the writes happen in input order, so the same code serves pipes and
+ *  terminals with write and seekable files with pwrite. a file is written
+ *  next to its path (as path.tmp.<pid>.<n>) and renamed over it on
+ *  finish, as an input that is also the output has to be read before the
+ *  output replaces it
+ */
+
+#ifndef MINIFY_BUNDLE_H
+#define MINIFY_BUNDLE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "string.h"
+
+#if !defined _WIN32 && !defined _WIN64 && !defined __EMSCRIPTEN__
+	#define MINIFY_HAS_PWRITE
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace minify {
+	class bundle_writer {
+		struct slot {
+			std::unique_ptr<minify::type::string> data;
+			std::atomic<std::ptrdiff_t> length,
+			                            offset;
+			std::atomic<bool> written;
+
+			slot() : length(-1), offset(-1), written(0) {}
+		};
+
+		std::vector<slot> slots_;
+		std::atomic<bool> failed_;
+		//bytes written once every slot is, set by whoever writes the last
+		std::ptrdiff_t total_ = 0;
+		//the file the bundle is for and the one it is written to until then
+		std::string path_,
+		            tmp_path_;
+		#ifdef MINIFY_HAS_PWRITE
+			int fd_ = -1;
+			bool seekable_ = 0,
+			     owns_fd_  = 0;
+		#else
+			FILE* f_ = nullptr;
+			bool owns_f_ = 0;
+		#endif
+
+		bool write_at(
+			char const* data,
+			std::ptrdiff_t length,
+			std::ptrdiff_t offset
+		) {
+			#ifdef MINIFY_HAS_PWRITE
+				while(length > 0) {
+					ssize_t const done = (seekable_)
+						? ::pwrite(fd_, data, length, offset)
+						: ::write(fd_, data, length);
+
+					if(done < 0) {
+						if(errno == EINTR)
+							continue;
+						return 0;
+					}
+
+					data   += done;
+					length -= done;
+					offset += done;
+				}
+
+				return 1;
+			#else
+				(void) offset;
+				return fwrite(data, 1, length, f_) == std::size_t(length);
+			#endif
+		}
+
+		static std::atomic<unsigned long>& next_writer() {
+			static std::atomic<unsigned long> n(0);
+			return n;
+		}
+
+		//renames the written file over path, or drops it when a write failed
+		void replace_path() {
+			if(failed_) {
+				std::remove(tmp_path_.c_str());
+				return;
+			}
+
+			#ifndef MINIFY_HAS_PWRITE
+				//windows will not rename over a file that exists
+				std::remove(path_.c_str());
+			#endif
+			if(std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+				std::remove(tmp_path_.c_str());
+				failed_ = 1;
+			}
+		}
+
+		//writes out slot i and the slots after it whose turn it now is
+		void advance(std::size_t i) {
+			for(; i<slots_.size(); ++i) {
+				std::ptrdiff_t const offset = slots_[i].offset.load(),
+				                     length = slots_[i].length.load();
+
+				if(offset < 0 || length < 0)
+					return;
+
+				//the slot goes to whoever claims it first, the others leave it be
+				if(slots_[i].written.exchange(1))
+					return;
+
+				if(length && !write_at(&(*slots_[i].data)[0], length, offset))
+					failed_ = 1;
+				slots_[i].data.reset();
+
+				//only now may the next slot be written, after this one
+				if(i+1 < slots_.size())
+					slots_[i+1].offset = offset + length;
+				else
+					total_ = offset + length;
+			}
+		}
+
+		public:
+		//bundles no_inputs inputs into the standard output
+		explicit bundle_writer(std::size_t const& no_inputs) :
+			slots_(no_inputs),
+			failed_(0) {
+			#ifdef MINIFY_HAS_PWRITE
+				fd_ = STDOUT_FILENO;
+			#else
+				f_ = stdout;
+			#endif
+
+			if(slots_.size())
+				slots_[0].offset = 0;
+		}
+
+		/*
+		 *  bundles no_inputs inputs into the file at path, sized up front to
+		 *  size_hint (what the inputs add up to) and cut to length on finish.
+		 *  path itself is left alone until then
+		 */
+		bundle_writer(
+			char const* path,
+			std::size_t const& no_inputs,
+			std::ptrdiff_t const& size_hint
+		) :
+			slots_(no_inputs),
+			failed_(0),
+			path_(path),
+			tmp_path_(path) {
+			#ifdef MINIFY_HAS_PWRITE
+				//several writers of a daemon may be at the same path at once
+				tmp_path_ += ".tmp." + std::to_string(::getpid()) + "." + std::to_string(next_writer()++);
+				fd_ = ::open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				owns_fd_  = (fd_ >= 0);
+				seekable_ = (fd_ >= 0 && ::lseek(fd_, 0, SEEK_CUR) == 0);
+
+				//reserves the space so the writes do not each grow the file
+				if(seekable_ && size_hint > 0 && ::ftruncate(fd_, size_hint) != 0)
+					seekable_ = 0;
+			#else
+				(void) size_hint;
+				tmp_path_ += ".tmp";
+				f_ = fopen(tmp_path_.c_str(), "wb");
+				owns_f_ = (f_ != nullptr);
+			#endif
+
+			if(slots_.size())
+				slots_[0].offset = 0;
+		}
+
+		bundle_writer(bundle_writer const&) = delete;
+		bundle_writer& operator=(bundle_writer const&) = delete;
+
+		~bundle_writer() {
+			finish();
+		}
+
+		//whether the output could be opened
+		bool is_open() const {
+			#ifdef MINIFY_HAS_PWRITE
+				return fd_ >= 0;
+			#else
+				return f_ != nullptr;
+			#endif
+		}
+
+		/*
+		 *  hands over the minified input i (nullptr for an input that is
+		 *  left out), written now if everything before it has been
+		 */
+		void publish(
+			std::size_t const& i,
+			std::unique_ptr<minify::type::string> data
+		) {
+			std::ptrdiff_t const length = (data) ? data->length() : 0;
+
+			slots_[i].data = std::move(data);
+			slots_[i].length = length;
+			advance(i);
+		}
+
+		//0 if any write failed
+		bool good() const {
+			return !failed_;
+		}
+
+		//appends text after the last input, once every input is written
+		bool append(
+			char const* text,
+			std::ptrdiff_t const& length
+		) {
+			if(!write_at(text, length, total_))
+				failed_ = 1;
+			else
+				total_ += length;
+
+			return good();
+		}
+
+		/*
+		 *  cuts the file down to what was written, closes it and moves it
+		 *  over path. the file at path is kept if any write failed
+		 */
+		void finish() {
+			#ifdef MINIFY_HAS_PWRITE
+				if(owns_fd_) {
+					if(seekable_ && ::ftruncate(fd_, total_) != 0)
+						failed_ = 1;
+					if(::close(fd_) != 0)
+						failed_ = 1;
+					owns_fd_ = 0;
+					fd_ = -1;
+					replace_path();
+				}
+			#else
+				if(owns_f_) {
+					if(fclose(f_) != 0)
+						failed_ = 1;
+					owns_f_ = 0;
+					f_ = nullptr;
+					replace_path();
+				}
+				else if(f_)
+					fflush(f_);
+			#endif
+		}
+	};
+}
+
+#endif //MINIFY_BUNDLE_H
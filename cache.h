@@ -0,0 +1,213 @@
+/**
+ *  content addressed cache of minified outputs (--cache DIR)
+ *
+ *  an entry is named for the xxh64 of the input bytes, seeded with
+ *  everything else the output depends on (the version, the comment
+ *  settings and the language it was minified as), plus the input's
+ *  length. entries are written under a name of their own and renamed
+ *  into place, so any number of processes can share a directory and a
+ *  reader never sees half an entry. a hit written to a file is copied
+ *  kernel side (a reflink where the filesystem shares extents, else
+ *  copy_file_range)
+ */
+
+#ifndef MINIFY_CACHE_H
+#define MINIFY_CACHE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "hash.h"
+#include "string.h"
+
+#if !defined _WIN32 && !defined _WIN64 && !defined __EMSCRIPTEN__
+	#define MINIFY_HAS_POSIX_IO
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+	#ifdef __linux__
+		#include <sys/ioctl.h>
+		#include <sys/syscall.h>
+		#include <linux/fs.h>
+		//linux/fs.h defines these as macros
+		#undef BLOCK_SIZE
+		#undef BLOCK_SIZE_BITS
+	#endif
+#endif
+
+namespace minify {
+	class result_cache {
+		std::string dir_;
+		std::uint64_t seed_ = 0;
+
+		public:
+		/*
+		 *  dir      - where the entries live, it must exist
+		 *  settings - everything besides the input the outputs depend on
+		 */
+		result_cache(
+			char const* dir,
+			std::string const& settings
+		) :
+			dir_(dir),
+			seed_(minify::xxh64(settings.data(), settings.length())) {
+			if(dir_.size() && dir_[dir_.size()-1] != '/')
+				dir_ += '/';
+		}
+
+		/*
+		 *  the path of the entry for length bytes of input at data, variant
+		 *  is what of the settings differs between inputs (the language)
+		 */
+		std::string entry(
+			char const* data,
+			std::ptrdiff_t const& length,
+			int const& variant = 0
+		) const {
+			char name[48];
+			snprintf(
+				name,
+				sizeof(name),
+				"%016llx-%llx",
+				(unsigned long long) minify::xxh64(data, length, seed_ + variant),
+				(unsigned long long) length
+			);
+
+			return dir_ + name;
+		}
+
+		//reads the entry at path into text, 0 on a miss
+		bool load(
+			std::string const& path,
+			minify::type::string& text
+		) const {
+			FILE* f = fopen(path.c_str(), "rb");
+			if(!f)
+				return 0;
+
+			text.length(0);
+			while(text.append(f, 1 << 16));
+			fclose(f);
+
+			return 1;
+		}
+
+		/*
+		 *  copies the entry at path to the file at out, 0 on a miss (or if
+		 *  out could not be written, for the caller to write it as usual)
+		 */
+		bool copy(
+			std::string const& path,
+			char const* out
+		) const {
+			#ifdef MINIFY_HAS_POSIX_IO
+				int const from = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+				if(from < 0)
+					return 0;
+
+				struct stat info;
+				int const to = (fstat(from, &info) == 0)
+					? ::open(out, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+					: -1;
+				if(to < 0) {
+					::close(from);
+					return 0;
+				}
+
+				bool copied = 0;
+
+				#ifdef FICLONE
+					copied = (ioctl(to, FICLONE, from) == 0);
+				#endif
+
+				#ifdef __NR_copy_file_range
+					for(off_t left = info.st_size; !copied;) {
+						if(!left) {
+							copied = 1;
+							break;
+						}
+
+						long const done = syscall(__NR_copy_file_range, from, nullptr, to, nullptr, left, 0);
+						if(done <= 0)
+							break;
+						left -= done;
+					}
+				#endif
+
+				//plain reads and writes where neither is supported (or one gave up part way)
+				if(!copied && lseek(from, 0, SEEK_SET) == 0 && ftruncate(to, 0) == 0 && lseek(to, 0, SEEK_SET) == 0) {
+					char buffer[1 << 16];
+					ssize_t got;
+
+					copied = 1;
+					while(copied && (got = ::read(from, buffer, sizeof(buffer))) > 0)
+						for(ssize_t put=0, done; put < got; put += done)
+							if((done = ::write(to, buffer + put, got - put)) <= 0) {
+								copied = 0;
+								break;
+							}
+					if(got < 0)
+						copied = 0;
+				}
+
+				::close(from);
+				return !::close(to) && copied;
+			#else
+				minify::type::string text;
+				if(!load(path, text))
+					return 0;
+
+				FILE* f = fopen(out, "wb");
+				if(!f)
+					return 0;
+
+				bool const saved = fwrite(&text[0], 1, text.length(), f) == std::size_t(text.length());
+				return !fclose(f) && saved;
+			#endif
+		}
+
+		/*
+		 *  adds text as the entry at path, written to a name of its own and
+		 *  renamed into place. 0 if that failed, the cache is only ever a
+		 *  shortcut so callers carry on regardless
+		 */
+		bool store(
+			std::string const& path,
+			minify::type::string const& text
+		) const {
+			static std::atomic<unsigned long> counter(0);
+			char suffix[64];
+			snprintf(
+				suffix,
+				sizeof(suffix),
+				".%ld.%lu.tmp",
+				#ifdef MINIFY_HAS_POSIX_IO
+					(long) getpid(),
+				#else
+					0L,
+				#endif
+				counter++
+			);
+			std::string const temp = path + suffix;
+
+			FILE* f = fopen(temp.c_str(), "wb");
+			if(!f)
+				return 0;
+
+			bool const written = fwrite(&text[0], 1, text.length(), f) == std::size_t(text.length());
+			if(fclose(f) || !written || rename(temp.c_str(), path.c_str())) {
+				remove(temp.c_str());
+				return 0;
+			}
+
+			return 1;
+		}
+	};
+}
+
+#endif //MINIFY_CACHE_H
@@ -0,0 +1,166 @@
+/**
+ *  compile time character class tables
+ *
+ *  every byte maps to a bitmask of the classes it belongs to, so a
+ *  predicate such as is_special_css_property_char is one load and
+ *  one mask instead of a chain of comparisons. the tables are built
+ *  from the comparison chains below by the compiler (c++11 constexpr)
+ */
+
+#ifndef MINIFY_CHAR_CLASS_H
+#define MINIFY_CHAR_CLASS_H
+
+#include <cstddef>
+
+namespace minify {
+	enum char_class_t : unsigned short {
+		cc_whitespace        = 1 << 0,
+		cc_inline_whitespace = 1 << 1,
+		cc_open_brace        = 1 << 2,
+		cc_close_brace       = 1 << 3,
+		cc_quote             = 1 << 4,
+		cc_word              = 1 << 5,
+		cc_css_selector      = 1 << 6,
+		cc_css_property      = 1 << 7,
+		cc_js_continues      = 1 << 8, //always continues a js statement
+		cc_js_operator       = 1 << 9, //continues one unless repeated, eg. ++
+		cc_js_closes         = 1 << 10,
+		cc_js_identifier     = 1 << 11
+	};
+
+	static constexpr unsigned short classify(
+		char const& c
+	) {
+		return (
+			((
+				c == ' '  ||
+				c == '\t' ||
+				c == '\n' ||
+				c == '\r'
+			) ? cc_whitespace : 0) |
+			((
+				c == ' '  ||
+				c == '\t'
+			) ? cc_inline_whitespace : 0) |
+			((
+				c == '{'  ||
+				c == '('  ||
+				c == '['
+			) ? cc_open_brace : 0) |
+			((
+				c == '}'  ||
+				c == ')'  ||
+				c == ']'
+			) ? cc_close_brace : 0) |
+			((
+				c == '\'' ||
+				c == '"'  ||
+				c == '`'
+			) ? cc_quote : 0) |
+			((
+				('0' <= c && c <= '9') ||
+				('a' <= c && c <= 'z') ||
+				('A' <= c && c <= 'Z') ||
+				c == '_'
+			) ? cc_word : 0) |
+			((
+				c == ',' ||
+				c == '{' ||
+				c == ')' ||
+				c == '>' ||
+				c == '+' ||
+				c == '~' ||
+				c == '"' ||
+				c == '\''
+			) ? cc_css_selector : 0) |
+			((
+				c == ',' ||
+				c == '{' ||
+				c == ')' ||
+				c == '>' ||
+				c == '+' ||
+				c == '~' ||
+				c == '}' ||
+				c == ':' ||
+				c == '!' ||
+				c == '#' ||
+				c == '*' ||
+				c == '=' ||
+				c == '(' ||
+				c == '[' ||
+				c == ']' ||
+				c == '<'
+			) ? cc_css_property : 0) |
+			((
+				c == '{'  ||
+				c == '['  ||
+				c == '('  ||
+				c == '<'  ||
+				c == '='  ||
+				c == '|'  ||
+				c == '&'  ||
+				c == '?'  ||
+				c == '.'  ||
+				c == ','  ||
+				c == ':'  ||
+				c == '%'  ||
+				c == '\\'
+			) ? cc_js_continues : 0) |
+			((
+				c == '+'  ||
+				c == '-'  ||
+				c == '*'  ||
+				c == '/'
+			) ? cc_js_operator : 0) |
+			((
+				c == '}' ||
+				c == ')' ||
+				c == ']' ||
+				c == '>'
+			) ? cc_js_closes : 0) |
+			((
+				('0' <= c && c <= '9') ||
+				('a' <= c && c <= 'z') ||
+				('A' <= c && c <= 'Z') ||
+				c == '_' ||
+				c == '$' ||
+				(unsigned char) c >= 0x80 //utf-8 identifiers
+			) ? cc_js_identifier : 0)
+		);
+	}
+
+	template <std::size_t... I>
+	struct index_list {
+	};
+
+	template <std::size_t N, std::size_t... I>
+	struct make_index_list : make_index_list<N-1, N-1, I...> {
+	};
+
+	template <std::size_t... I>
+	struct make_index_list<0, I...> {
+		typedef index_list<I...> type;
+	};
+
+	struct char_class_table {
+		unsigned short bits[256];
+	};
+
+	template <std::size_t... I>
+	static constexpr char_class_table make_char_class_table(
+		index_list<I...>
+	) {
+		return char_class_table{{ classify(char(I))... }};
+	}
+
+	static constexpr char_class_table char_classes =
+		make_char_class_table(make_index_list<256>::type());
+
+	static constexpr unsigned short char_class(
+		char const& c
+	) {
+		return char_classes.bits[(unsigned char) c];
+	}
+}
+
+#endif //MINIFY_CHAR_CLASS_H
@@ -0,0 +1,1624 @@
+/**
+ *  cli.h: the command line driver's state and the ways it runs
+ *
+ *  kept apart from mantis-minify.h so the minifiers can be built into a
+ *  library (see engine.h) without the globals the executables work from
+ */
+
+#ifndef MANTIS_MINIFY_CLI_H
+#define MANTIS_MINIFY_CLI_H
+
+#include "mantis-minify.h"
+#include "pipe.h"
+#include "scheduler.h"
+#include "cpus.h"
+#include "bundle.h"
+#include "uring.h"
+#include "cache.h"
+#include "engine.h"
+#include "watch.h"
+#include "daemon.h"
+#include "serve.h"
+
+#include <sys/stat.h>
+inline bool path_exists(minify::type::string const& path) {
+	struct stat info;
+
+	if(stat(path.c_str(), &info ) != 0) 
+		return 0; //does not exist
+	else
+		return 1; //exists
+}
+inline bool dir_exists(minify::type::string const& path) {
+	struct stat info;
+
+	if(stat( path.c_str(), &info ) != 0) 
+		return 0; //path doesn't exist
+	else if(info.st_mode & S_IFDIR) 
+		return 1; //dir
+	else 
+		return 0; //file
+}
+inline bool file_exists(minify::type::string const& path) {
+	struct stat info;
+
+	if(stat( path.c_str(), &info ) != 0) 
+		return 0; //path nonexistent
+	else if(info.st_mode & S_IFDIR) 
+		return 0; //dir
+	else 
+		return 1; //file
+}
+
+//whether a and b are the same file, by device and inode as names can differ
+inline bool same_file(char const* a, char const* b) {
+	struct stat info_a, info_b;
+
+	if(stat(a, &info_a) != 0 || stat(b, &info_b) != 0)
+		return 0;
+
+	return info_a.st_dev == info_b.st_dev && info_a.st_ino == info_b.st_ino;
+}
+
+inline int make_dir(minify::type::string const& dir) {
+	#if defined _WIN32 || defined _WIN64
+		return _mkdir(
+			dir.c_str()
+		); //windows 
+	#else 
+		return mkdir(
+			dir.c_str(), 
+			S_IRWXU | 
+			S_IRWXG | 
+			S_IROTH | 
+			S_IXOTH
+		); //*[bsd|nix]
+	#endif
+}
+
+inline int create_dirs(minify::type::string const& path) {
+	minify::type::string dir;
+
+	for(std::ptrdiff_t i=0; i<path.length(); ++i) {
+		if(path[i] == '/' || path[i] == '\\') {
+			dir.substr(path, 0, i);
+			if(!dir_exists(dir) && make_dir(dir))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*#include <unistd.h>
+#include <fcntl.h>
+#ifdef _WIN32
+	#include <direct.h>
+#endif
+
+inline bool create_file(minify::type::string const& path) {
+	if(path.length())
+	{
+		close(creat(path.c_str(), O_CREAT));
+		chmod(path.c_str(), 0644);
+	}
+
+	return 0;
+}*/
+
+inline void get_filename(
+	minify::type::string& path,
+	minify::type::string& file
+) {
+	for(std::size_t i=path.length()-1; i!=std::string::npos; --i) {
+		if(path[i] == '/' || path[i] == '\\') {
+			file.substr(
+				path,
+				i+1, 
+				path.length()-i-1);
+			break;
+		}
+	}
+
+}
+
+inline void append_filename(
+	minify::type::string& path,
+	minify::type::string& dir
+) {
+	for(std::size_t i=path.length()-1; i!=std::string::npos; --i) {
+		if(path[i] == '/' || path[i] == '\\') {
+			dir.append_substr(
+				path,
+				i+1, 
+				path.length()-i-1);
+			break;
+		}
+	}
+
+}
+
+//writes text to path by its length, so a NUL in it does not cut it short
+inline bool save_file(
+	char const* path,
+	minify::type::string const& text
+) {
+	FILE* f = fopen(path, "w");
+	if(!f)
+		return 0;
+
+	bool const saved = fwrite(&text[0], 1, text.length(), f) == std::size_t(text.length());
+
+	return !fclose(f) && saved;
+}
+
+enum class output_t {
+	file,
+	directory,
+	terminal
+};
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+static bool minify_comments = 1;
+static comment_mode_t comment_mode = comment_mode_t::strip_all;
+static lang_t lang = lang_t::unspecified;
+static output_t output_type = output_t::terminal;
+//the cores no worker is using, for splitting large inputs
+static minify::thread_budget spare_threads(0);
+//inputs at least this large are mapped rather than read into the heap
+static std::ptrdiff_t const map_threshold = 1 << 16;
+static std::vector<char const*> to_minify;
+static minify::type::string exec_name, specified_output_path;
+//threads to use at most (-j, else available_cpus) and whether to pin them
+static std::size_t no_jobs = 0;
+static bool pin_workers = 0;
+//--cost-history: where per file minify rates are kept between runs
+static minify::type::string cost_history_path;
+static std::vector<double> input_nanoseconds;
+static bool stream_mode = 0,
+            stdin_mode  = 0,
+            ndjson_mode = 0;
+//whether batches of small inputs go through io_uring where there is one
+static bool use_uring = 1;
+//--cache: where outputs are kept by the hash of their input
+static minify::type::string cache_dir;
+static bool watch_mode = 0;
+//--daemon: where to listen, --client: where to find a daemon to forward to
+static minify::type::string daemon_socket,
+                            client_socket;
+//--serve: the directory served over http, on port (of the loopback address)
+static minify::type::string serve_dir;
+static int serve_port = 8080;
+//how many bytes of minified files --serve keeps in memory
+static std::size_t const serve_cache_bytes = std::size_t(64) << 20;
+//how long a burst of changes must have been quiet for before --watch acts on it
+static int const watch_quiet_ms = 5;
+
+//the language of the input at path, --css, --html, --js or --json over its extension
+inline lang_t input_lang(char const* path) {
+	return (lang != lang_t::unspecified) ? lang : path_lang(path);
+}
+
+//errors held back while a bundle goes to stdout (see report_error)
+static std::mutex held_errors_mtx;
+static std::vector<std::string> held_errors;
+static bool hold_errors = 0;
+
+/*
+ *  prints an error to stderr in one write, as other workers may be
+ *  reporting too. while minified output goes to stdout as inputs finish,
+ *  the errors wait for it to end so they are not printed midway along
+ *  its line (see print_held_errors)
+ */
+inline void report_error(std::string const& message) {
+	std::ostringstream line;
+	line << "error: " << exec_name << ": " << message << '\n';
+
+	std::lock_guard<std::mutex> lock(held_errors_mtx);
+	if(hold_errors)
+		held_errors.push_back(line.str());
+	else
+		std::cerr << line.str() << std::flush;
+}
+
+inline void print_held_errors() {
+	std::lock_guard<std::mutex> lock(held_errors_mtx);
+	for(std::size_t e=0; e<held_errors.size(); ++e)
+		std::cerr << held_errors[e];
+	std::cerr << std::flush;
+	held_errors.clear();
+	hold_errors = 0;
+}
+
+/*
+ *  bundle - where the minified inputs go for the terminal or -o, nullptr
+ *           when they are written to a directory (-d)
+ *  cache  - outputs from earlier runs (--cache), or nullptr
+ *  cpus   - the cpus to pin the worker to (--pin), or empty
+ */
+inline void minify_thrd(
+	minify::scheduler& schedule,
+	std::size_t const worker,
+	minify::bundle_writer* bundle,
+	minify::result_cache const* cache,
+	std::vector<int> const& cpus
+) {
+	std::size_t i=0;
+	minify::scheduler::task task;
+	//everything a file needs is drawn from buffers and released in one go
+	minify::type::arena buffers;
+	minify::type::string code(buffers),
+	                     mapped,
+	                     minified(buffers),
+	                     input_path(buffers),
+	                     output_path(buffers);
+	//output for the bundle, handed over as it may outlive the arena reset
+	std::unique_ptr<minify::type::string> owned;
+	minify::type::string* src;
+	minify::type::string* dst;
+	std::size_t const& no_cores = no_jobs;
+	//a task of several (small) inputs is read, and written to -d, in one go
+	minify::uring ring(use_uring ? 64 : 0);
+	std::vector<char const*> batch_paths;
+	std::vector<std::unique_ptr<minify::type::string> > batch_texts,
+	                                                    batch_outputs;
+	std::vector<std::string> batch_output_paths;
+	std::vector<minify::type::string const*> batch_output_texts;
+	std::vector<bool> batch_written;
+
+	if(cpus.size())
+		minify::pin_to_cpu(cpus[worker % cpus.size()]);
+
+	while(schedule.next(worker, task)) {
+		bool const batched = ring.ready() && task.last - task.first > 1;
+
+		if(batched) {
+			batch_paths.clear();
+			for(std::size_t t=task.first; t<task.last; ++t)
+				batch_paths.push_back(to_minify[schedule.input(t)]);
+
+			minify::uring_read_files(ring, batch_paths, batch_texts);
+		}
+
+		for(std::size_t t=task.first; t<task.last; ++t) {
+			std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+			i = schedule.input(t);
+
+			code.drop();
+			minified.drop();
+			input_path.drop();
+			output_path.drop();
+			buffers.reset();
+
+			input_path.assign(to_minify[i]);
+
+			//anything the ring could not read goes the blocking way
+			if(batched)
+				owned = std::move(batch_texts[t - task.first]);
+
+			if(owned || file_exists(input_path)) {
+				if(owned)
+					src = dst = owned.get();
+				//large inputs are minified straight out of a read-only mapping
+				else if(mapped.map_file(to_minify[i], map_threshold)) {
+					if(bundle)
+						owned.reset(new minify::type::string());
+
+					src = &mapped;
+					dst = (bundle) ? owned.get() : &minified;
+				}
+				else {
+					if(bundle)
+						owned.reset(new minify::type::string());
+
+					src = dst = (bundle) ? owned.get() : &code;
+					dst->load_file(to_minify[i]);
+				}
+
+				if(output_type == output_t::directory) {
+					output_path.assign(specified_output_path.c_str());
+					append_filename(input_path, output_path);
+				}
+
+				//each input is minified as its own language, so one run can take a mix
+				lang_t file_lang = input_lang(to_minify[i]);
+				if(file_lang == lang_t::unspecified)
+					file_lang = sniff_lang(&(*src)[0], src->length());
+
+				//with --cache an input seen before is served from the entry for it
+				bool cached = 0;
+				std::string entry;
+				if(cache && file_lang != lang_t::unspecified) {
+					entry = cache->entry(&(*src)[0], src->length(), int(file_lang));
+					cached = (output_type == output_t::directory)
+						? cache->copy(entry, output_path.c_str())
+						: cache->load(entry, *dst);
+				}
+
+				if(file_lang == lang_t::unspecified) {
+					report_error(
+						"could not tell the language of '" + std::string(input_path.c_str()) + "', "
+						"use one of --css, --html, --js, --json"
+					);
+				}
+				else if(!cached) {
+					//this worker's thread plus whatever it can borrow, never more than the cores in all
+					std::size_t const lent = worth_splitting(file_lang, src->length(), no_cores)
+						? spare_threads.claim(no_cores - 1)
+						: 0;
+					std::size_t const no_threads = 1 + lent;
+					//a page borrows only once it is known to hold enough inline code (see splice_inline_blocks)
+					bool const may_borrow = lent || (
+						file_lang == lang_t::html &&
+						src->length() >= inline_parallel_threshold
+					);
+
+					//the threads a split starts run where this one may, so not on its cpu alone
+					if(may_borrow && cpus.size())
+						minify::pin_to_cpus(cpus);
+
+					if(worth_splitting(file_lang, src->length(), no_threads))
+						minify_split(
+							file_lang,
+							*src,
+							*dst,
+							minify_comments,
+							comment_mode,
+							no_threads
+						);
+					else switch(file_lang) {
+						case lang_t::css:
+							minify_css(
+								*src, 
+								*dst, 
+								minify_comments, 
+								comment_mode
+							);
+							break;
+						case lang_t::html:
+							minify_html(
+								*src, 
+								*dst, 
+								minify_comments, 
+								comment_mode,
+								0,
+								no_cores,
+								&spare_threads
+							);
+							break;
+						case lang_t::js:
+							minify_js(
+								*src, 
+								*dst, 
+								minify_comments, 
+								comment_mode
+							);
+							break;
+						case lang_t::json:
+							minify_json(
+								*src, 
+								*dst, 
+								minify_comments, 
+								comment_mode
+							);
+							break;
+						default:
+							break;
+					}
+					spare_threads.release(lent);
+
+					if(may_borrow && cpus.size())
+						minify::pin_to_cpu(cpus[worker % cpus.size()]);
+
+					if(cache)
+						cache->store(entry, *dst);
+				}
+				mapped.drop();
+
+				//owned holds the input for one that could not be minified
+				if(bundle && file_lang == lang_t::unspecified)
+					bundle->publish(i, nullptr);
+				else if(bundle)
+					bundle->publish(i, std::move(owned));
+				else if(output_type == output_t::directory && !cached && file_lang != lang_t::unspecified) {
+					//kept to be written with the rest of the batch
+					if(owned) {
+						batch_output_paths.push_back(output_path.c_str());
+						batch_outputs.push_back(std::move(owned));
+					}
+					else if(!save_file(output_path.c_str(), *dst))
+						report_error("failed to write '" + std::string(output_path.c_str()) + "'");
+				}
+			}
+			else
+			{
+				//the inputs after it still need their offsets
+				if(bundle)
+					bundle->publish(i, nullptr);
+
+				report_error("source file '" + std::string(input_path.c_str()) + "' does not exist");
+			}
+
+			owned.reset();
+
+			if(input_nanoseconds.size())
+				input_nanoseconds[i] = std::chrono::duration<double, std::nano>(
+					std::chrono::steady_clock::now() - start
+				).count();
+		}
+
+		if(batch_outputs.size()) {
+			batch_paths.clear();
+			batch_output_texts.clear();
+			for(std::size_t o=0; o<batch_outputs.size(); ++o) {
+				batch_paths.push_back(batch_output_paths[o].c_str());
+				batch_output_texts.push_back(batch_outputs[o].get());
+			}
+
+			minify::uring_write_files(ring, batch_paths, batch_output_texts, batch_written);
+
+			for(std::size_t o=0; o<batch_outputs.size(); ++o)
+				if(!batch_written[o] && !save_file(batch_paths[o], *batch_outputs[o]))
+					report_error("failed to write '" + std::string(batch_paths[o]) + "'");
+
+			batch_output_paths.clear();
+			batch_outputs.clear();
+		}
+	}
+
+	//out of inputs, the others may split with this thread
+	spare_threads.release(1);
+
+	//worker 0 is the main thread, which goes on after the run on every cpu it had
+	if(cpus.size())
+		minify::pin_to_cpus(cpus);
+}
+
+/*
+ *  stats the inputs, deals them out to up to no_workers threads (see
+ *  scheduler, there are no more threads than tasks and the calling
+ *  thread is one of them) and minifies them. bundles are written as the
+ *  inputs finish (see bundle_writer). with --cost-history the time each
+ *  input took is kept to order the next run by
+ */
+inline void minify_scheduled(std::size_t const& no_workers) {
+	minify::cost_history history;
+	std::vector<double> sizes(to_minify.size()),
+	                    costs(to_minify.size());
+	double total_size = 0;
+	struct stat info;
+
+	if(cost_history_path.length()) {
+		history.load(cost_history_path.c_str());
+		input_nanoseconds.assign(to_minify.size(), 0);
+	}
+
+	for(std::size_t i=0; i<to_minify.size(); ++i) {
+		if(stat(to_minify[i], &info) == 0)
+			sizes[i] = info.st_size;
+		costs[i] = history.estimate(to_minify[i], sizes[i]);
+		total_size += sizes[i];
+	}
+
+	std::unique_ptr<minify::bundle_writer> bundle;
+	if(output_type == output_t::terminal) {
+		std::cout.flush();
+		bundle.reset(new minify::bundle_writer(to_minify.size()));
+		hold_errors = 1;
+	}
+	else if(output_type == output_t::file) {
+		bundle.reset(new minify::bundle_writer(
+			specified_output_path.c_str(),
+			to_minify.size(),
+			total_size
+		));
+
+		if(!bundle->is_open()) {
+			report_error("could not open '" + std::string(specified_output_path.c_str()) + "'");
+			return;
+		}
+	}
+
+	//inputs under 64 KiB are batched, a task each would cost more to hand out
+	minify::scheduler schedule(
+		costs,
+		no_workers,
+		(1 << 16) * history.mean_rate()
+	);
+	std::vector<std::thread> thrds;
+	std::vector<int> const cpus = (pin_workers) ? minify::allowed_cpus() : std::vector<int>();
+
+	//everything besides the input an output depends on
+	std::unique_ptr<minify::result_cache> cache;
+	if(cache_dir.length())
+		cache.reset(new minify::result_cache(
+			cache_dir.c_str(),
+			std::string(version) +
+				" comment_mode=" + std::to_string(int(comment_mode)) +
+				" minify_comments=" + std::to_string(int(minify_comments))
+		));
+
+	auto work = [&schedule, &cpus, &bundle, &cache](std::size_t const w) {
+		minify_thrd(schedule, w, bundle.get(), cache.get(), cpus);
+	};
+
+	//threads of -j without a worker of their own go to splitting large inputs
+	spare_threads.release(no_jobs - schedule.workers());
+	for(std::size_t w=1; w<schedule.workers(); ++w)
+		thrds.push_back(std::thread(work, w));
+	work(0);
+	for(std::size_t t=0; t<thrds.size(); ++t)
+		thrds[t].join();
+
+	if(bundle) {
+		if(output_type == output_t::terminal)
+			bundle->append("\n", 1);
+		bundle->finish();
+		print_held_errors();
+
+		if(!bundle->good())
+			report_error("failed to write the minified output");
+	}
+
+	if(cost_history_path.length()) {
+		for(std::size_t i=0; i<to_minify.size(); ++i)
+			history.record(to_minify[i], sizes[i], input_nanoseconds[i]);
+		history.save(cost_history_path.c_str());
+	}
+}
+
+/*
+ *  --stream: minifies the files one after another a block at a time,
+ *  output is written as it is produced so no file is ever held whole
+ */
+inline void minify_streamed() {
+	minify::type::string input_path,
+	                     output_path;
+	minify::type::string_view minified;
+	FILE* in;
+	FILE* out = stdout;
+
+	if(output_type == output_t::file && !(out = fopen(specified_output_path.c_str(), "w"))) {
+		report_error("could not open '" + std::string(specified_output_path.c_str()) + "'");
+		return;
+	}
+	hold_errors = (output_type == output_t::terminal);
+
+	for(std::size_t i=0; i<to_minify.size(); ++i) {
+		input_path.assign(to_minify[i]);
+
+		if(!file_exists(input_path) || !(in = fopen(to_minify[i], "rb"))) {
+			report_error("source file '" + std::string(input_path.c_str()) + "' does not exist");
+			continue;
+		}
+
+		lang_t const file_lang = input_lang(to_minify[i]);
+		if(file_lang != lang_t::css && file_lang != lang_t::json) {
+			report_error("--stream supports css and json, '" + std::string(input_path.c_str()) + "' is neither");
+			fclose(in);
+			continue;
+		}
+
+		if(output_type == output_t::directory) {
+			output_path.assign(specified_output_path.c_str());
+			append_filename(input_path, output_path);
+
+			if(!(out = fopen(output_path.c_str(), "w"))) {
+				report_error("could not open '" + std::string(output_path.c_str()) + "'");
+				fclose(in);
+				continue;
+			}
+		}
+
+		minify::stream stream(file_lang, minify_comments, comment_mode);
+
+		while(!stream.finished() && !feof(in) && !ferror(in)) {
+			minified = stream.read(in);
+			fwrite(minified.data(), 1, minified.length(), out);
+		}
+		minified = stream.finish();
+		fwrite(minified.data(), 1, minified.length(), out);
+
+		fclose(in);
+		if(output_type == output_t::directory)
+			fclose(out);
+	}
+
+	if(output_type == output_t::terminal)
+		fputs("\n", stdout);
+	else if(output_type == output_t::file)
+		fclose(out);
+
+	fflush(stdout);
+	print_held_errors();
+}
+
+//--ndjson splits inputs into batches of about this many bytes
+static std::ptrdiff_t const ndjson_batch_size = 1 << 18;
+
+/*
+ *  minifies the newline separated json records in [begin, end) of
+ *  ndjson one at a time, appending each to out on a line of its own.
+ *  blank lines are dropped
+ */
+inline void minify_ndjson_records(
+	minify::type::string const& ndjson,
+	std::ptrdiff_t begin,
+	std::ptrdiff_t const& end,
+	minify::type::string& record,
+	minify::type::string& minified,
+	minify::type::string& out
+) {
+	char const* line_end;
+
+	while(begin < end) {
+		line_end = (char const*) memchr(&ndjson[begin], '\n', end - begin);
+		std::ptrdiff_t const next = line_end ? line_end - ndjson.c_str() : end;
+
+		std::ptrdiff_t const length = next - begin;
+
+		//plain records are minified straight from the input onto the end of out
+		out.smart_resize(out.length() + length + minify::simd::json_padding + 2);
+		std::ptrdiff_t const written = minify::simd::minify_json(&ndjson[begin], length, &out[out.length()]);
+
+		if(written >= 0) {
+			if(written) {
+				out.length(out.length() + written);
+				out.append("\n", 1);
+			}
+
+			begin = next + 1;
+			continue;
+		}
+
+		//the rest (comments, ' quotes) need the byte wise minifier, which takes a whole string
+		record.length(0);
+		record.append(&ndjson[begin], length);
+		minify_json(
+			record,
+			minified,
+			minify_comments,
+			comment_mode
+		);
+
+		if(minified.length()) {
+			out.append(minified.c_str(), minified.length());
+			out.append("\n", 1);
+		}
+
+		begin = next + 1;
+	}
+}
+
+/*
+ *  --ndjson: json lines (one json record per line) are minified a record
+ *  at a time, keeping one record per line. each input is split into
+ *  batches at newlines (which can not occur inside a json string), the
+ *  batches are minified on every core and written out in order as they
+ *  complete, so output starts before the whole input is done
+ */
+inline void minify_ndjson() {
+	minify::type::string ndjson,
+	                     input_path,
+	                     output_path;
+	std::vector<std::ptrdiff_t> bounds;
+	std::vector<minify::type::string> batches;
+	std::vector<char> done;
+	std::atomic<std::size_t> next;
+	std::mutex done_mtx;
+	std::condition_variable done_cv;
+	FILE* out = stdout;
+
+	std::size_t const& no_threads = no_jobs;
+
+	if(output_type == output_t::file && !(out = fopen(specified_output_path.c_str(), "w"))) {
+		report_error("could not open '" + std::string(specified_output_path.c_str()) + "'");
+		return;
+	}
+	hold_errors = (output_type == output_t::terminal);
+
+	for(std::size_t i=0; i<to_minify.size() || (stdin_mode && !i); ++i) {
+		ndjson.drop();
+
+		if(stdin_mode) {
+			while(ndjson.append(stdin, std::ptrdiff_t(minify::stream::BLOCK_SIZE)));
+		}
+		else {
+			input_path.assign(to_minify[i]);
+
+			if(!file_exists(input_path)) {
+				report_error("source file '" + std::string(input_path.c_str()) + "' does not exist");
+				continue;
+			}
+
+			if(output_type == output_t::directory) {
+				output_path.assign(specified_output_path.c_str());
+				append_filename(input_path, output_path);
+
+				if(!(out = fopen(output_path.c_str(), "w"))) {
+					report_error("could not open '" + std::string(output_path.c_str()) + "'");
+					continue;
+				}
+			}
+
+			if(!ndjson.map_file(to_minify[i], map_threshold))
+				ndjson.load_file(to_minify[i]);
+		}
+
+		//batches end just past a newline
+		bounds.assign(1, 0);
+		while(bounds.back() < ndjson.length()) {
+			std::ptrdiff_t const target = bounds.back() + ndjson_batch_size;
+
+			if(target >= ndjson.length()) {
+				bounds.push_back(ndjson.length());
+				break;
+			}
+
+			char const* newline = (char const*) memchr(
+				&ndjson[target],
+				'\n',
+				ndjson.length() - target
+			);
+			bounds.push_back(newline ? newline - ndjson.c_str() + 1 : ndjson.length());
+		}
+
+		std::size_t const no_batches = bounds.size() - 1;
+		batches = std::vector<minify::type::string>(no_batches);
+		done.assign(no_batches, 0);
+		next = 0;
+
+		auto minify_batches = [&] {
+			minify::type::string record,
+			                     minified;
+			std::size_t b;
+
+			while((b = next++) < no_batches) {
+				minify_ndjson_records(
+					ndjson,
+					bounds[b],
+					bounds[b+1],
+					record,
+					minified,
+					batches[b]
+				);
+
+				std::lock_guard<std::mutex> lock(done_mtx);
+				done[b] = 1;
+				done_cv.notify_all();
+			}
+		};
+
+		std::vector<std::thread> thrds;
+		for(std::size_t t=0; t<std::min(no_threads, no_batches); ++t)
+			thrds.push_back(std::thread(minify_batches));
+
+		for(std::size_t b=0; b<no_batches; ++b) {
+			{
+				std::unique_lock<std::mutex> lock(done_mtx);
+				done_cv.wait(lock, [&] { return done[b] != 0; });
+			}
+
+			fwrite(batches[b].c_str(), 1, batches[b].length(), out);
+			batches[b].drop();
+		}
+
+		for(std::size_t t=0; t<thrds.size(); ++t)
+			thrds[t].join();
+
+		if(output_type == output_t::directory)
+			fclose(out);
+	}
+
+	ndjson.drop();
+
+	if(output_type == output_t::file)
+		fclose(out);
+
+	fflush(stdout);
+	print_held_errors();
+}
+
+/*
+ *  - or --stdin: minifies standard input to the output as a pipeline, one
+ *  thread reads, one minifies and one writes, handing blocks along
+ *  through double buffers. css and json are minified a block at a time
+ *  as they arrive, js and html have no safe cut points so they are
+ *  gathered whole before minifying (the reads and writes still overlap)
+ */
+inline void minify_piped() {
+	minify::double_buffer input, output;
+	FILE* out = stdout;
+
+	if(output_type == output_t::file && !(out = fopen(specified_output_path.c_str(), "w"))) {
+		report_error("could not open '" + std::string(specified_output_path.c_str()) + "'");
+		return;
+	}
+
+	std::thread reader([&input] {
+		for(;;) {
+			minify::type::string& block = input.to_fill();
+
+			if(!block.append_available(stdin, std::ptrdiff_t(minify::stream::BLOCK_SIZE)))
+				break;
+			input.filled();
+		}
+		input.close();
+	});
+
+	std::thread writer([&output, out] {
+		minify::type::string* block;
+
+		while((block = output.to_drain())) {
+			fwrite(block->c_str(), 1, block->length(), out);
+			fflush(out);
+			output.drained();
+		}
+	});
+
+	auto emit = [&output](char const* data, std::ptrdiff_t const& length) {
+		if(!length)
+			return;
+
+		output.to_fill().append(data, length);
+		output.filled();
+	};
+
+	minify::type::string* block;
+
+	if(lang == lang_t::css || lang == lang_t::json) {
+		minify::stream stream(lang, minify_comments, comment_mode);
+		minify::type::string_view minified;
+
+		//after a css </style the rest is still read so the writer upstream is not cut off
+		while((block = input.to_drain())) {
+			minified = stream.push(block->c_str(), block->length());
+			input.drained();
+			emit(minified.data(), minified.length());
+		}
+		minified = stream.finish();
+		emit(minified.data(), minified.length());
+	}
+	else {
+		minify::type::string source;
+
+		while((block = input.to_drain())) {
+			source.append(block->c_str(), block->length());
+			input.drained();
+		}
+
+		if(lang == lang_t::js)
+			minify_js(source, minify_comments, comment_mode);
+		else
+			minify_html(source, minify_comments, comment_mode);
+		emit(source.c_str(), source.length());
+	}
+
+	if(output_type == output_t::terminal)
+		emit("\n", 1);
+
+	output.close();
+	writer.join();
+	reader.join();
+
+	if(output_type == output_t::file)
+		fclose(out);
+}
+
+#ifdef MINIFY_HAS_DAEMON
+#include <condition_variable>
+#include <deque>
+#include <new>
+#include <csignal>
+#include <numeric>
+
+//reads the whole file at path into text, 0 if it could not be opened
+inline bool read_file(
+	char const* path,
+	std::string& text
+) {
+	FILE* f = fopen(path, "rb");
+	if(!f)
+		return 0;
+
+	char buffer[1 << 16];
+	std::size_t got;
+
+	text.clear();
+	while((got = fread(buffer, 1, sizeof(buffer), f)))
+		text.append(buffer, got);
+	fclose(f);
+
+	return 1;
+}
+
+//writes all of text to fd at offset, 0 on an error
+inline bool pwrite_all(
+	int const& fd,
+	std::string const& text,
+	off_t offset
+) {
+	for(std::size_t done=0; done<text.length();) {
+		ssize_t const put = pwrite(fd, text.data() + done, text.length() - done, offset);
+
+		if(put < 0) {
+			if(errno == EINTR)
+				continue;
+			return 0;
+		}
+
+		done   += put;
+		offset += put;
+	}
+
+	return 1;
+}
+
+//minifies what req asks for, run on the daemon's pool
+inline minify::result serve_request(minify::daemon::request const& req) {
+	minify::result out;
+	minify::options opts;
+	std::string text;
+
+	if(req.lang > (unsigned char) lang_t::unspecified || req.comment_mode > (unsigned char) comment_mode_t::strip_all) {
+		out.error = "malformed request";
+		return out;
+	}
+	opts.comment_mode    = comment_mode_t(req.comment_mode);
+	opts.minify_comments = req.minify_comments;
+
+	if(req.from_path && !read_file(req.input.c_str(), text)) {
+		out.error = "source file '" + req.input + "' does not exist";
+		return out;
+	}
+
+	std::string const& source = (req.from_path) ? text : req.input;
+
+	//unspecified asks for the language to be told from the input
+	lang_t source_lang = lang_t(req.lang);
+	if(source_lang == lang_t::unspecified && req.from_path)
+		source_lang = path_lang(req.input.c_str());
+	if(source_lang == lang_t::unspecified)
+		source_lang = sniff_lang(source.data(), source.length());
+	if(source_lang == lang_t::unspecified) {
+		out.error = "could not tell the language of '" + ((req.from_path) ? req.input : "the input") + "'";
+		return out;
+	}
+
+	out = minify::engine::run(source.data(), source.length(), source_lang, opts);
+
+	//written next to the output and renamed over it, as -o is (see bundle_writer)
+	if(out.ok && req.output_path.length()) {
+		minify::bundle_writer output(req.output_path.c_str(), 1, out.code.length());
+		bool const opened = output.is_open();
+
+		if(opened) {
+			output.publish(0, nullptr);
+			output.append(out.code.data(), out.code.length());
+			output.finish();
+		}
+
+		if(!opened || !output.good()) {
+			out.ok = 0;
+			out.error = "could not write '" + req.output_path + "'";
+		}
+		out.code.clear();
+	}
+
+	return out;
+}
+
+/*
+ *  answers the requests on one connection in order. each goes to the pool
+ *  as soon as it is read, so a client can have many in flight at once
+ */
+inline void serve_connection(
+	int const fd,
+	minify::engine& engine
+) {
+	std::deque<std::future<minify::result> > in_flight;
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool read_all = 0;
+
+	std::thread replier([&] {
+		bool connected = 1;
+
+		for(;;) {
+			std::future<minify::result> next;
+
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [&] { return in_flight.size() || read_all; });
+
+				if(in_flight.empty())
+					return;
+
+				next = std::move(in_flight.front());
+				in_flight.pop_front();
+			}
+
+			minify::result minified;
+			try {
+				minified = next.get();
+			}
+			catch(std::bad_alloc const&) {
+				minified.error = "out of memory";
+			}
+
+			minify::daemon::reply rep;
+			rep.ok = minified.ok;
+			rep.data = (minified.ok) ? std::move(minified.code) : std::move(minified.error);
+
+			//the rest are still waited for, the pool must not outlive its jobs
+			connected = connected && minify::daemon::send_reply(fd, rep);
+		}
+	});
+
+	//a request too large to hold ends its connection, not the daemon
+	try {
+		minify::daemon::request req;
+		while(minify::daemon::recv_request(fd, req)) {
+			std::shared_ptr<minify::daemon::request> job = std::make_shared<minify::daemon::request>(std::move(req));
+			std::future<minify::result> done = engine.submit([job] {
+				return serve_request(*job);
+			});
+
+			std::lock_guard<std::mutex> lock(mtx);
+			in_flight.push_back(std::move(done));
+			cv.notify_one();
+		}
+	}
+	catch(std::bad_alloc const&) {
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		read_all = 1;
+	}
+	cv.notify_one();
+
+	replier.join();
+	close(fd);
+}
+
+/*
+ *  --daemon: minifies what clients (--client) send over the unix socket at
+ *  path, on one pool of threads kept for as long as the daemon runs
+ */
+inline void minify_daemon(char const* path) {
+	int const listener = minify::daemon::listen_at(path);
+	if(listener < 0) {
+		if(listener == -2)
+			report_error("'" + std::string(path) + "' exists and is not a socket, not replacing it");
+		else
+			report_error("could not listen at '" + std::string(path) + "' (is a daemon already running?)");
+		return;
+	}
+
+	minify::options settings;
+	settings.no_threads = no_jobs;
+	minify::engine engine(settings);
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::size_t connections = 0;
+
+	std::cout << "listening at " << path << std::endl;
+
+	for(;;) {
+		int const fd = accept(listener, nullptr, nullptr);
+
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			++connections;
+		}
+		std::thread([fd, &engine, &mtx, &cv, &connections] {
+			serve_connection(fd, engine);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			--connections;
+			cv.notify_all();
+		}).detach();
+	}
+
+	close(listener);
+	unlink(path);
+
+	//the engine and the count are on this stack, the connections go first
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [&connections] { return !connections; });
+}
+
+//path made absolute against the working directory, the daemon's is not ours
+inline std::string absolute_path(char const* path) {
+	if(path[0] == '/')
+		return path;
+
+	char cwd[4096];
+	if(!getcwd(cwd, sizeof(cwd)))
+		return path;
+
+	return std::string(cwd) + "/" + path;
+}
+
+/*
+ *  --client: forwards the inputs to the daemon at path rather than
+ *  minifying them here, keeping up to 64 in flight. returns 0 without
+ *  doing anything if there is no daemon there, to minify locally instead
+ */
+inline bool minify_client(char const* path) {
+	int const fd = minify::daemon::connect_to(path);
+	if(fd < 0)
+		return 0;
+
+	std::size_t const window = 64;
+	FILE* out = stdout;
+	minify::type::string input_path,
+	                     output_path;
+	minify::daemon::request req;
+	minify::daemon::reply rep;
+
+	if(output_type == output_t::file && !(out = fopen(specified_output_path.c_str(), "w"))) {
+		report_error("could not open '" + std::string(specified_output_path.c_str()) + "'");
+		close(fd);
+		return 1;
+	}
+	hold_errors = (output_type == output_t::terminal);
+
+	req.comment_mode    = (unsigned char) comment_mode;
+	req.minify_comments = minify_comments;
+	req.from_path       = 1;
+
+	for(std::size_t sent=0, received=0; received<to_minify.size();) {
+		for(; sent<to_minify.size() && sent - received < window; ++sent) {
+			req.input = absolute_path(to_minify[sent]);
+			req.lang  = (unsigned char) input_lang(to_minify[sent]);
+			req.output_path.clear();
+
+			if(output_type == output_t::directory) {
+				input_path.assign(to_minify[sent]);
+				output_path.assign(specified_output_path.c_str());
+				append_filename(input_path, output_path);
+				req.output_path = absolute_path(output_path.c_str());
+			}
+
+			if(!minify::daemon::send_request(fd, req))
+				break;
+		}
+
+		if(!minify::daemon::recv_reply(fd, rep)) {
+			report_error("lost the connection to the daemon at '" + std::string(path) + "'");
+			break;
+		}
+		++received;
+
+		if(!rep.ok) {
+			report_error(rep.data);
+			continue;
+		}
+
+		if(output_type != output_t::directory)
+			fwrite(rep.data.data(), 1, rep.data.length(), out);
+	}
+
+	if(output_type == output_t::terminal)
+		fputs("\n", out);
+	if(out != stdout)
+		fclose(out);
+	close(fd);
+
+	fflush(stdout);
+	print_held_errors();
+
+	return 1;
+}
+
+/*
+ *  the asset to send for the file at path (of info), minified if it is
+ *  css, js, json or html. null if the file could not be read
+ */
+inline std::shared_ptr<minify::http::asset const> serve_asset(
+	std::string const& path,
+	struct stat const& info,
+	minify::engine& engine,
+	minify::http::asset_cache& cache
+) {
+	std::string const ext = minify::http::extension(path);
+	lang_t const file_lang = path_lang(path.c_str());
+	std::int64_t const mtime = minify::http::modified(info);
+
+	std::shared_ptr<minify::http::asset const> found = cache.find(path, mtime, info.st_size);
+	if(found)
+		return found;
+
+	std::shared_ptr<minify::http::asset> made = std::make_shared<minify::http::asset>();
+	made->type = minify::http::content_type(ext);
+
+	if(file_lang != lang_t::unspecified) {
+		std::string text;
+		if(!read_file(path.c_str(), text))
+			return nullptr;
+
+		minify::result minified = engine.submit(std::move(text), file_lang).get();
+
+		if(minified.ok) {
+			made->fd   = minify::http::memory_file(minified.code.data(), minified.code.length());
+			made->size = minified.code.length();
+			made->etag = minify::http::make_etag(minify::xxh64(minified.code.data(), minified.code.length()));
+
+			if(made->fd < 0)
+				return nullptr;
+
+			cache.insert(path, mtime, info.st_size, made);
+			return made;
+		}
+
+		//sent as it is rather than not at all
+		std::cout << "error: " << exec_name << ": " << path << ": " << minified.error << std::endl;
+	}
+
+	//everything else is sent straight from the file, which is its own cache
+	std::int64_t const version[2] = { mtime, std::int64_t(info.st_size) };
+	made->fd   = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	made->size = info.st_size;
+	made->etag = minify::http::make_etag(minify::xxh64(version, sizeof(version)));
+
+	return (made->fd < 0) ? nullptr : made;
+}
+
+//answers the http requests on one connection until it is closed
+inline void serve_http(
+	int const fd,
+	std::string const& root,
+	minify::engine& engine,
+	minify::http::asset_cache& cache
+) {
+	std::string buffer,
+	            path;
+	minify::http::request req;
+
+	for(;;) {
+		int const status = minify::http::read_request(fd, buffer, req);
+
+		if(!status)
+			break;
+		if(status != 200) {
+			minify::http::send_status(fd, status, 0);
+			break;
+		}
+
+		bool const head_only = (req.method == "HEAD");
+		if(!head_only && req.method != "GET") {
+			if(!minify::http::send_status(fd, 405, req.keep_alive, "Allow: GET, HEAD\r\n") || !req.keep_alive)
+				break;
+			continue;
+		}
+
+		if(!minify::http::local_path(req.target, path)) {
+			minify::http::send_status(fd, 400, 0);
+			break;
+		}
+
+		path = root + path;
+		struct stat info;
+		bool found = !stat(path.c_str(), &info);
+
+		if(found && S_ISDIR(info.st_mode)) {
+			//relative links in the index resolve against the directory only with its slash
+			if(path[path.size()-1] != '/') {
+				std::string target = req.target;
+				target.insert(std::min(target.find_first_of("?#"), target.size()), "/");
+
+				if(!minify::http::send_status(fd, 301, req.keep_alive, "Location: " + target + "\r\n") || !req.keep_alive)
+					break;
+				continue;
+			}
+
+			path += "index.html";
+			found = !stat(path.c_str(), &info);
+		}
+
+		//links may point anywhere, what they resolve to must still be under root
+		if(found) {
+			//a root of / already ends in the separator
+			std::size_t const prefix = root.size() - (root[root.size()-1] == '/');
+			char* resolved = realpath(path.c_str(), nullptr);
+			found = resolved && S_ISREG(info.st_mode) &&
+			        !strncmp(resolved, root.c_str(), prefix) && resolved[prefix] == '/';
+			free(resolved);
+		}
+
+		std::shared_ptr<minify::http::asset const> asset;
+		if(found)
+			asset = serve_asset(path, info, engine, cache);
+
+		if(!asset) {
+			if(!minify::http::send_status(fd, (found) ? 403 : 404, req.keep_alive) || !req.keep_alive)
+				break;
+			continue;
+		}
+
+		std::string const headers = "ETag: " + asset->etag + "\r\nContent-Type: " + asset->type + "\r\n";
+
+		if(req.if_none_match.size() && minify::http::etag_matches(req.if_none_match, asset->etag)) {
+			std::string const head = minify::http::response_head(304, -1, req.keep_alive, "ETag: " + asset->etag + "\r\n");
+			if(!minify::daemon::send_all(fd, head.data(), head.size()))
+				break;
+		}
+		else {
+			std::string const head = minify::http::response_head(200, asset->size, req.keep_alive, headers);
+			if(
+				!minify::daemon::send_all(fd, head.data(), head.size()) ||
+				(!head_only && !minify::http::send_file(fd, asset->fd, asset->size))
+			)
+				break;
+		}
+
+		if(!req.keep_alive)
+			break;
+	}
+
+	close(fd);
+}
+
+/*
+ *  --serve: serves the files under dir over http on the loopback address,
+ *  minifying css, js, json and html on the first request for each
+ */
+inline void minify_served(char const* dir) {
+	char* resolved = realpath(dir, nullptr);
+	std::string const root = (resolved) ? resolved : "";
+	free(resolved);
+
+	struct stat info;
+	if(root.empty() || stat(root.c_str(), &info) || !S_ISDIR(info.st_mode)) {
+		std::cout << "error: " << exec_name << ": ";
+		std::cout << "can not serve '" << dir << "', it is not a directory" << std::endl;
+		return;
+	}
+
+	int const listener = minify::http::listen_on(serve_port);
+	if(listener < 0) {
+		std::cout << "error: " << exec_name << ": ";
+		std::cout << "could not listen on port " << serve_port << std::endl;
+		return;
+	}
+
+	//a client going away mid sendfile must not end the server
+	signal(SIGPIPE, SIG_IGN);
+
+	minify::options settings;
+	settings.comment_mode    = comment_mode;
+	settings.minify_comments = minify_comments;
+	settings.no_threads      = no_jobs;
+	minify::engine engine(settings);
+	minify::http::asset_cache cache(serve_cache_bytes);
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	std::size_t connections = 0;
+
+	std::cout << "serving " << root << " at http://127.0.0.1:" << serve_port << "/" << std::endl;
+
+	for(;;) {
+		int const fd = accept(listener, nullptr, nullptr);
+
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;
+		}
+
+		//idle connections are dropped, each holds a thread
+		timeval const idle = { 30, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			++connections;
+		}
+		std::thread([fd, &root, &engine, &cache, &mtx, &cv, &connections] {
+			serve_http(fd, root, engine, cache);
+
+			std::lock_guard<std::mutex> lock(mtx);
+			--connections;
+			cv.notify_all();
+		}).detach();
+	}
+
+	close(listener);
+
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [&connections] { return !connections; });
+}
+
+#ifdef __linux__
+/*
+ *  --watch: minifies the inputs, then again each time some of them change
+ *  until killed. the threads are kept between rounds (see minify::engine)
+ *  and only the inputs that changed are minified. -d rewrites their
+ *  outputs, -o rewrites their regions of the bundle, and everything after
+ *  the first output that changed length
+ */
+inline void minify_watched() {
+	minify::options settings;
+	settings.comment_mode    = comment_mode;
+	settings.minify_comments = minify_comments;
+	settings.no_threads      = no_jobs;
+
+	minify::engine engine(settings);
+	minify::watcher watcher(to_minify);
+	//the bundle as it stands, an output per input
+	std::vector<std::string> outputs(to_minify.size());
+	std::vector<std::size_t> changed(to_minify.size()),
+	                         submitted,
+	                         patched;
+	std::vector<std::future<minify::result> > pending;
+	//where each output starts in the bundle, and where the bundle ends
+	std::vector<off_t> offsets(1, 0);
+	std::string code;
+	int bundle = -1;
+
+	if(!watcher.ready()) {
+		std::cout << "error: " << exec_name << ": ";
+		std::cout << "could not watch the inputs (inotify)" << std::endl;
+		return;
+	}
+
+	//an output that is also an input would be wiped, and each write of it would start another round
+	for(std::size_t i=0; i<to_minify.size(); ++i) {
+		minify::type::string input_path(to_minify[i]),
+		                     output_path;
+
+		if(output_type == output_t::file)
+			output_path.assign(specified_output_path.c_str());
+		else if(output_type == output_t::directory) {
+			output_path.assign(specified_output_path.c_str());
+			append_filename(input_path, output_path);
+		}
+
+		if(output_path.length() && same_file(to_minify[i], output_path.c_str())) {
+			std::cout << "error: " << exec_name << ": ";
+			std::cout << "can not watch '" << to_minify[i] << "', it is also the output" << std::endl;
+			return;
+		}
+	}
+
+	if(output_type == output_t::file) {
+		bundle = open(specified_output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+		if(bundle < 0) {
+			std::cout << "error: " << exec_name << ": ";
+			std::cout << "could not open '" << specified_output_path << "'" << std::endl;
+			return;
+		}
+	}
+
+	//the first round minifies everything
+	std::iota(changed.begin(), changed.end(), std::size_t(0));
+
+	do {
+		std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+
+		pending.clear();
+		submitted.clear();
+		for(std::size_t c=0; c<changed.size(); ++c) {
+			//mid rename, the event for the new file is still to come
+			if(!read_file(to_minify[changed[c]], code))
+				continue;
+
+			lang_t file_lang = input_lang(to_minify[changed[c]]);
+			if(file_lang == lang_t::unspecified)
+				file_lang = sniff_lang(code.data(), code.length());
+			if(file_lang == lang_t::unspecified) {
+				std::cout << "error: " << exec_name << ": ";
+				std::cout << "could not tell the language of '" << to_minify[changed[c]] << "', ";
+				std::cout << "use one of --css, --html, --js, --json" << std::endl;
+				continue;
+			}
+
+			pending.push_back(engine.submit(std::move(code), file_lang));
+			submitted.push_back(changed[c]);
+		}
+
+		std::size_t first_moved = outputs.size();
+		patched.clear();
+		for(std::size_t s=0; s<pending.size(); ++s) {
+			std::size_t const& i = submitted[s];
+			minify::result minified;
+			try {
+				minified = pending[s].get();
+			}
+			catch(std::bad_alloc const&) {
+				minified.error = "out of memory";
+			}
+
+			//the output from the last round stays until the input minifies again
+			if(!minified.ok) {
+				std::cout << "error: " << exec_name << ": ";
+				std::cout << "could not minify '" << to_minify[i] << "': " << minified.error << std::endl;
+				continue;
+			}
+
+			if(output_type == output_t::directory) {
+				minify::type::string input_path(to_minify[i]),
+				                     output_path;
+				output_path.assign(specified_output_path.c_str());
+				append_filename(input_path, output_path);
+
+				FILE* f = fopen(output_path.c_str(), "w");
+				if(!f) {
+					std::cout << "error: " << exec_name << ": ";
+					std::cout << "could not open '" << output_path << "'" << std::endl;
+					continue;
+				}
+
+				bool written = (fwrite(minified.code.data(), 1, minified.code.length(), f) == minified.code.length());
+				if(fclose(f))
+					written = 0;
+
+				if(!written) {
+					std::cout << "error: " << exec_name << ": ";
+					std::cout << "failed to write '" << output_path << "'" << std::endl;
+				}
+			}
+			else {
+				if(minified.code.length() != outputs[i].length())
+					first_moved = std::min(first_moved, i);
+				else
+					patched.push_back(i);
+
+				outputs[i] = std::move(minified.code);
+			}
+		}
+
+		if(bundle >= 0) {
+			bool written = 1;
+
+			offsets.resize(outputs.size() + 1);
+			for(std::size_t i=0; i<outputs.size(); ++i)
+				offsets[i+1] = offsets[i] + outputs[i].length();
+
+			//outputs the same length as before are patched where they are
+			for(std::size_t p=0; p<patched.size(); ++p)
+				if(patched[p] < first_moved)
+					written &= pwrite_all(bundle, outputs[patched[p]], offsets[patched[p]]);
+
+			for(std::size_t i=first_moved; i<outputs.size(); ++i)
+				written &= pwrite_all(bundle, outputs[i], offsets[i]);
+			if(first_moved < outputs.size() && ftruncate(bundle, offsets.back()))
+				written = 0;
+
+			if(!written) {
+				std::cout << "error: " << exec_name << ": ";
+				std::cout << "failed to write '" << specified_output_path << "'" << std::endl;
+			}
+		}
+
+		std::cout << "minified " << submitted.size() << " file(s) in "
+		          << std::chrono::duration<double, std::milli>(
+		             	std::chrono::steady_clock::now() - start
+		             ).count()
+		          << " ms" << std::endl;
+	} while(watcher.wait(changed, watch_quiet_ms));
+
+	if(bundle >= 0)
+		close(bundle);
+}
+#endif //__linux__
+#endif //MINIFY_HAS_DAEMON
+
+#endif //MANTIS_MINIFY_CLI_H
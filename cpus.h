@@ -0,0 +1,150 @@
+/**
+ *  how many cpus the process may really use, and pinning threads to them
+ *
+ *  std::thread::hardware_concurrency counts every core on the host, in a
+ *  container limited by a cgroup cpu quota or a cpuset (or under taskset)
+ *  that oversubscribes. available_cpus takes the least of the cores, the
+ *  affinity mask and the quota (rounded up)
+ */
+
+#ifndef MINIFY_CPUS_H
+#define MINIFY_CPUS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace minify {
+	//the cpus this process may run on, empty where that can not be told
+	static inline std::vector<int> allowed_cpus() {
+		std::vector<int> cpus;
+
+		#ifdef __linux__
+			cpu_set_t set;
+			CPU_ZERO(&set);
+
+			if(sched_getaffinity(0, sizeof(set), &set) == 0)
+				for(int c=0; c<CPU_SETSIZE; ++c)
+					if(CPU_ISSET(c, &set))
+						cpus.push_back(c);
+		#endif
+
+		return cpus;
+	}
+
+	/*
+	 *  the cpus a cgroup quota allows (rounded up), 0 without a quota.
+	 *  for cgroup v2 the limits of the process's own cgroup and every
+	 *  parent count, for v1 the cpu controller's root (as seen from inside
+	 *  a container)
+	 */
+	static inline std::size_t cgroup_cpu_quota() {
+		double cpus = 0;
+
+		#ifdef __linux__
+			std::string path;
+			char line[4096];
+
+			if(FILE* f = fopen("/proc/self/cgroup", "r")) {
+				while(fgets(line, sizeof(line), f))
+					if(!strncmp(line, "0::", 3)) {
+						path = line + 3;
+						path.erase(path.find_last_not_of("\n") + 1);
+					}
+				fclose(f);
+			}
+
+			for(;;) {
+				std::string const dir = "/sys/fs/cgroup" + ((path == "/") ? std::string() : path);
+
+				if(FILE* f = fopen((dir + "/cpu.max").c_str(), "r")) {
+					char quota[32];
+					double period;
+
+					if(
+						fscanf(f, "%31s %lf", quota, &period) == 2 &&
+						strcmp(quota, "max") &&
+						period > 0
+					) {
+						double const limit = atof(quota) / period;
+
+						if(limit > 0 && (!cpus || limit < cpus))
+							cpus = limit;
+					}
+					fclose(f);
+				}
+
+				if(path.empty() || path == "/")
+					break;
+				path.erase(std::max<std::size_t>(path.rfind('/'), 1));
+			}
+
+			if(!cpus) {
+				FILE* q = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+				FILE* p = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+				double quota, period;
+
+				if(
+					q && p &&
+					fscanf(q, "%lf", &quota) == 1 &&
+					fscanf(p, "%lf", &period) == 1 &&
+					quota > 0 && period > 0
+				)
+					cpus = quota / period;
+
+				if(q)
+					fclose(q);
+				if(p)
+					fclose(p);
+			}
+		#endif
+
+		return (cpus > 0) ? std::size_t(cpus + 0.999) : 0;
+	}
+
+	//the most threads worth running at once
+	static inline std::size_t available_cpus() {
+		std::size_t cpus = std::max(std::thread::hardware_concurrency(), 1u);
+		std::size_t const allowed = allowed_cpus().size(),
+		                  quota   = cgroup_cpu_quota();
+
+		if(allowed)
+			cpus = std::min(cpus, allowed);
+		if(quota)
+			cpus = std::min(cpus, quota);
+
+		return cpus;
+	}
+
+	//keeps the calling thread on cpus (some of allowed_cpus), 0 if it can not
+	static inline bool pin_to_cpus(std::vector<int> const& cpus) {
+		#ifdef __linux__
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for(std::size_t c=0; c<cpus.size(); ++c)
+				CPU_SET(cpus[c], &set);
+
+			return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		#else
+			(void) cpus;
+			return 0;
+		#endif
+	}
+
+	//keeps the calling thread on cpu (one of allowed_cpus), 0 if it can not
+	static inline bool pin_to_cpu(int const& cpu) {
+		return pin_to_cpus(std::vector<int>(1, cpu));
+	}
+}
+
+#endif //MINIFY_CPUS_H
@@ -0,0 +1,270 @@
+/**
+ *  the protocol between --daemon and --client, over a unix domain socket
+ *
+ *  a connection carries any number of requests, each answered in order.
+ *  a request is a 20 byte header, then the input, then the output path:
+ *
+ *  	0   'm' 'm' and the protocol version (1)
+ *  	3   language (lang_t, unspecified to go by the extension or content),
+ *  	    comment mode, whether comments are minified (a byte each)
+ *  	6   1 if the input is a path for the daemon to read, 0 if it is the bytes
+ *  	8   input length (8 bytes, little endian)
+ *  	16  output path length (4 bytes, little endian), 0 to be sent the output
+ *
+ *  a reply is a status byte (0 ok, 1 failed), 7 zero bytes and a length
+ *  (8 bytes, little endian), then that many bytes: the minified output,
+ *  nothing if it was written to the output path, or the error
+ */
+
+#ifndef MINIFY_DAEMON_H
+#define MINIFY_DAEMON_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if !defined _WIN32 && !defined _WIN64 && !defined __EMSCRIPTEN__
+	#define MINIFY_HAS_DAEMON
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+#ifdef MINIFY_HAS_DAEMON
+namespace minify {
+	namespace daemon {
+		static constexpr unsigned char version = 1;
+		//requests claiming more than these are refused, and their connection closed
+		static constexpr std::uint64_t max_input       = std::uint64_t(1) << 30,
+		                               max_output_path = 4096;
+
+		struct request {
+			unsigned char lang            = 0,
+			              comment_mode    = 0,
+			              minify_comments = 1;
+			bool from_path = 0;
+			std::string input,
+			            output_path;
+		};
+
+		struct reply {
+			bool ok = 0;
+			std::string data;
+		};
+
+		//sends all of length bytes, 0 if the connection failed
+		inline bool send_all(
+			int const& fd,
+			void const* data,
+			std::size_t length
+		) {
+			char const* p = (char const*) data;
+
+			while(length) {
+				#ifdef MSG_NOSIGNAL
+					ssize_t const sent = ::send(fd, p, length, MSG_NOSIGNAL);
+				#else
+					ssize_t const sent = ::send(fd, p, length, 0);
+				#endif
+
+				if(sent < 0) {
+					if(errno == EINTR)
+						continue;
+					return 0;
+				}
+
+				p      += sent;
+				length -= sent;
+			}
+
+			return 1;
+		}
+
+		//receives exactly length bytes, 0 if the connection failed or closed first
+		inline bool recv_all(
+			int const& fd,
+			void* data,
+			std::size_t length
+		) {
+			char* p = (char*) data;
+
+			while(length) {
+				ssize_t const got = ::recv(fd, p, length, 0);
+
+				if(got < 0 && errno == EINTR)
+					continue;
+				if(got <= 0)
+					return 0;
+
+				p      += got;
+				length -= got;
+			}
+
+			return 1;
+		}
+
+		inline void put_le(
+			unsigned char* p,
+			std::uint64_t value,
+			int const& bytes
+		) {
+			for(int b=0; b<bytes; ++b, value >>= 8)
+				p[b] = value & 0xff;
+		}
+
+		inline std::uint64_t get_le(
+			unsigned char const* p,
+			int const& bytes
+		) {
+			std::uint64_t value = 0;
+			for(int b=bytes-1; b>=0; --b)
+				value = value << 8 | p[b];
+			return value;
+		}
+
+		inline bool send_request(
+			int const& fd,
+			request const& req
+		) {
+			unsigned char header[20] = { 'm', 'm', version };
+			header[3] = req.lang;
+			header[4] = req.comment_mode;
+			header[5] = req.minify_comments;
+			header[6] = req.from_path;
+			put_le(&header[8], req.input.length(), 8);
+			put_le(&header[16], req.output_path.length(), 4);
+
+			return send_all(fd, header, sizeof(header)) &&
+			       send_all(fd, req.input.data(), req.input.length()) &&
+			       send_all(fd, req.output_path.data(), req.output_path.length());
+		}
+
+		/*
+		 *  0 at the end of the connection, or on a request that is not ours
+		 *  or is too large (see max_input). can throw std::bad_alloc
+		 */
+		inline bool recv_request(
+			int const& fd,
+			request& req
+		) {
+			unsigned char header[20];
+
+			if(
+				!recv_all(fd, header, sizeof(header)) ||
+				header[0] != 'm' || header[1] != 'm' || header[2] != version
+			)
+				return 0;
+
+			std::uint64_t const input_length       = get_le(&header[8], 8),
+			                    output_path_length = get_le(&header[16], 4);
+			if(input_length > max_input || output_path_length > max_output_path)
+				return 0;
+
+			req.lang            = header[3];
+			req.comment_mode    = header[4];
+			req.minify_comments = header[5];
+			req.from_path       = header[6];
+			req.input.resize(input_length);
+			req.output_path.resize(output_path_length);
+
+			return (req.input.empty() || recv_all(fd, &req.input[0], req.input.length())) &&
+			       (req.output_path.empty() || recv_all(fd, &req.output_path[0], req.output_path.length()));
+		}
+
+		inline bool send_reply(
+			int const& fd,
+			reply const& rep
+		) {
+			unsigned char header[16] = { (unsigned char) !rep.ok };
+			put_le(&header[8], rep.data.length(), 8);
+
+			return send_all(fd, header, sizeof(header)) &&
+			       send_all(fd, rep.data.data(), rep.data.length());
+		}
+
+		inline bool recv_reply(
+			int const& fd,
+			reply& rep
+		) {
+			unsigned char header[16];
+
+			if(!recv_all(fd, header, sizeof(header)))
+				return 0;
+
+			rep.ok = !header[0];
+			rep.data.resize(get_le(&header[8], 8));
+
+			return rep.data.empty() || recv_all(fd, &rep.data[0], rep.data.length());
+		}
+
+		//a unix socket at path, -1 if path is too long or the socket failed
+		inline int open_socket(
+			std::string const& path,
+			sockaddr_un& address
+		) {
+			address = sockaddr_un();
+			address.sun_family = AF_UNIX;
+
+			if(path.length() >= sizeof(address.sun_path))
+				return -1;
+			path.copy(address.sun_path, path.length());
+
+			return ::socket(AF_UNIX, SOCK_STREAM, 0);
+		}
+
+		//connects to the daemon at path, -1 if there is none
+		inline int connect_to(std::string const& path) {
+			sockaddr_un address;
+			int const fd = open_socket(path, address);
+
+			if(fd >= 0 && ::connect(fd, (sockaddr const*) &address, sizeof(address))) {
+				::close(fd);
+				return -1;
+			}
+
+			return fd;
+		}
+
+		/*
+		 *  listens at path (only for this user), replacing a socket left
+		 *  behind by a daemon that is gone. -1 if a daemon is still there
+		 *  or the socket failed, -2 if something besides a socket is at
+		 *  path (which is left alone)
+		 */
+		inline int listen_at(std::string const& path) {
+			struct stat info;
+			if(!::lstat(path.c_str(), &info)) {
+				if(!S_ISSOCK(info.st_mode))
+					return -2;
+
+				int const running = connect_to(path);
+				if(running >= 0) {
+					::close(running);
+					return -1;
+				}
+				::unlink(path.c_str());
+			}
+
+			sockaddr_un address;
+			int const fd = open_socket(path, address);
+			if(fd < 0)
+				return -1;
+
+			mode_t const mask = ::umask(0077);
+			bool const bound = !::bind(fd, (sockaddr const*) &address, sizeof(address));
+			::umask(mask);
+
+			if(!bound || ::listen(fd, 64)) {
+				::close(fd);
+				return -1;
+			}
+
+			return fd;
+		}
+	}
+}
+#endif
+
+#endif //MINIFY_DAEMON_H
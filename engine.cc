@@ -0,0 +1,139 @@
+#include "engine.h"
+#include "cpus.h"
+
+namespace minify {
+	engine::engine(options const& opts) :
+		options_(opts) {
+		std::size_t const no_threads = (options_.no_threads)
+			? options_.no_threads
+			: minify::available_cpus();
+
+		//the workers call through the kernel table, which must not change under them
+		minify::simd::freeze_isa();
+
+		for(std::size_t t=0; t<no_threads; ++t)
+			workers_.push_back(std::thread(&engine::work, this));
+	}
+
+	engine::~engine() {
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			stopping_ = 1;
+		}
+		cv_.notify_all();
+
+		for(std::size_t t=0; t<workers_.size(); ++t)
+			workers_[t].join();
+	}
+
+	void engine::work() {
+		for(;;) {
+			std::packaged_task<result()> job;
+
+			{
+				std::unique_lock<std::mutex> lock(mtx_);
+				cv_.wait(lock, [this] { return jobs_.size() || stopping_; });
+
+				if(jobs_.empty())
+					return;
+
+				job = std::move(jobs_.front());
+				jobs_.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	std::future<result> engine::submit(
+		std::string buffer,
+		lang_t const& lang
+	) {
+		//shared rather than copied into the job, c++11 lambdas can not capture by move
+		std::shared_ptr<std::string> text = std::make_shared<std::string>(std::move(buffer));
+
+		return submit([this, text, lang] {
+			return run(text->data(), text->length(), lang);
+		});
+	}
+
+	std::future<result> engine::submit(std::function<result()> job) {
+		std::packaged_task<result()> task(std::move(job));
+		std::future<result> done = task.get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			jobs_.push_back(std::move(task));
+		}
+		cv_.notify_one();
+
+		return done;
+	}
+
+	std::future<result> engine::submit(
+		char const* data,
+		std::size_t const& length,
+		lang_t const& lang
+	) {
+		return submit(std::string(data, length), lang);
+	}
+
+	result engine::run(
+		char const* data,
+		std::size_t const& length,
+		lang_t const& lang
+	) const {
+		return run(data, length, lang, options_);
+	}
+
+	result engine::run(
+		char const* data,
+		std::size_t const& length,
+		lang_t const& lang,
+		options const& opts
+	) {
+		result out;
+		minify::type::string code;
+
+		code.append(data, length);
+
+		switch(lang) {
+			case lang_t::css:
+				minify_css(
+					code,
+					opts.minify_comments,
+					opts.comment_mode
+				);
+				break;
+			case lang_t::html:
+				minify_html(
+					code,
+					opts.minify_comments,
+					opts.comment_mode
+				);
+				break;
+			case lang_t::js:
+				minify_js(
+					code,
+					opts.minify_comments,
+					opts.comment_mode
+				);
+				break;
+			case lang_t::json:
+				minify_json(
+					code,
+					opts.minify_comments,
+					opts.comment_mode
+				);
+				break;
+			default:
+				out.error = "no language specified";
+				return out;
+		}
+
+		out.code.assign(code.c_str(), code.length());
+		out.ok = 1;
+
+		return out;
+	}
+}
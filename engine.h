@@ -0,0 +1,108 @@
+/**
+ *  engine.h: minifying in-process on a long-lived pool of threads
+ *
+ * 	example:
+ * 		minify::engine engine;
+ * 		std::future<minify::result> css = engine.submit(text, lang_t::css);
+ * 		std::cout << css.get().code;
+ *
+ *  built into libmantis-minify.a and libmantis-minify.so (make lib), the
+ *  options are the engine's own so any number of engines can live side by
+ *  side in one process
+ *
+ *  the vector level (minify::simd::set_isa) is shared by the whole
+ *  process and can only be capped before the first engine is created,
+ *  set_isa returns 0 from then on
+ */
+
+#ifndef MANTIS_MINIFY_ENGINE_H
+#define MANTIS_MINIFY_ENGINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mantis-minify.h"
+
+namespace minify {
+	struct options {
+		comment_mode_t comment_mode = comment_mode_t::strip_all;
+		//0 leaves the comments that are kept as they are (--raw-comments)
+		bool minify_comments = 1;
+		//threads in the pool, 0 for as many as there are cpus available
+		std::size_t no_threads = 0;
+	};
+
+	struct result {
+		std::string code;
+		//0 with the reason in error, code is then empty
+		bool ok = 0;
+		std::string error;
+	};
+
+	class engine {
+		options options_;
+		std::vector<std::thread> workers_;
+		std::deque<std::packaged_task<result()> > jobs_;
+		std::mutex mtx_;
+		std::condition_variable cv_;
+		bool stopping_ = 0;
+
+		void work();
+
+		public:
+		explicit engine(options const& opts = options());
+		//finishes the jobs already submitted, then stops the pool
+		~engine();
+
+		engine(engine const&) = delete;
+		engine& operator=(engine const&) = delete;
+
+		//queues buffer to be minified as lang by the pool
+		std::future<result> submit(
+			std::string buffer,
+			lang_t const& lang
+		);
+
+		//as submit(buffer, lang), length bytes are copied from data first
+		std::future<result> submit(
+			char const* data,
+			std::size_t const& length,
+			lang_t const& lang
+		);
+
+		//runs job on the pool, so reading and writing around a run can happen there too
+		std::future<result> submit(std::function<result()> job);
+
+		//minifies on the calling thread, bypassing the pool
+		result run(
+			char const* data,
+			std::size_t const& length,
+			lang_t const& lang
+		) const;
+
+		//as run(data, length, lang) with the comment settings of opts
+		static result run(
+			char const* data,
+			std::size_t const& length,
+			lang_t const& lang,
+			options const& opts
+		);
+
+		std::size_t threads() const {
+			return workers_.size();
+		}
+
+		options const& settings() const {
+			return options_;
+		}
+	};
+}
+
+#endif //MANTIS_MINIFY_ENGINE_H
@@ -0,0 +1,117 @@
+/**
+ *  xxh64, a fast non-cryptographic hash (see github.com/Cyan4973/xxHash),
+ *  kept in-tree so there is nothing to depend on. inputs are read as
+ *  little endian, the only byte order the values are compared across
+ */
+
+#ifndef MINIFY_HASH_H
+#define MINIFY_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace minify {
+	namespace xxh64_detail {
+		static constexpr std::uint64_t P1 = 0x9E3779B185EBCA87ULL,
+		                               P2 = 0xC2B2AE3D27D4EB4FULL,
+		                               P3 = 0x165667B19E3779F9ULL,
+		                               P4 = 0x85EBCA77C2B2AE63ULL,
+		                               P5 = 0x27D4EB2F165667C5ULL;
+
+		static inline std::uint64_t rotl(
+			std::uint64_t const& x,
+			int const& r
+		) {
+			return (x << r) | (x >> (64 - r));
+		}
+
+		static inline std::uint64_t read64(unsigned char const* p) {
+			std::uint64_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		static inline std::uint32_t read32(unsigned char const* p) {
+			std::uint32_t v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+
+		static inline std::uint64_t round(
+			std::uint64_t acc,
+			std::uint64_t const& input
+		) {
+			acc += input * P2;
+			return rotl(acc, 31) * P1;
+		}
+
+		static inline std::uint64_t merge(
+			std::uint64_t acc,
+			std::uint64_t const& v
+		) {
+			acc ^= round(0, v);
+			return acc * P1 + P4;
+		}
+	}
+
+	inline std::uint64_t xxh64(
+		void const* data,
+		std::size_t length,
+		std::uint64_t const& seed = 0
+	) {
+		using namespace xxh64_detail;
+
+		unsigned char const* p = (unsigned char const*) data;
+		unsigned char const* const end = p + length;
+		std::uint64_t h;
+
+		if(length >= 32) {
+			std::uint64_t v1 = seed + P1 + P2,
+			              v2 = seed + P2,
+			              v3 = seed,
+			              v4 = seed - P1;
+
+			for(; p + 32 <= end; p += 32) {
+				v1 = round(v1, read64(p));
+				v2 = round(v2, read64(p + 8));
+				v3 = round(v3, read64(p + 16));
+				v4 = round(v4, read64(p + 24));
+			}
+
+			h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+			h = merge(h, v1);
+			h = merge(h, v2);
+			h = merge(h, v3);
+			h = merge(h, v4);
+		}
+		else
+			h = seed + P5;
+
+		h += length;
+
+		for(; p + 8 <= end; p += 8) {
+			h ^= round(0, read64(p));
+			h = rotl(h, 27) * P1 + P4;
+		}
+		if(p + 4 <= end) {
+			h ^= std::uint64_t(read32(p)) * P1;
+			h = rotl(h, 23) * P2 + P3;
+			p += 4;
+		}
+		for(; p < end; ++p) {
+			h ^= (*p) * P5;
+			h = rotl(h, 11) * P1;
+		}
+
+		h ^= h >> 33;
+		h *= P2;
+		h ^= h >> 29;
+		h *= P3;
+		h ^= h >> 32;
+
+		return h;
+	}
+}
+
+#endif //MINIFY_HASH_H
@@ -0,0 +1,200 @@
+/**
+ *  compile time perfect hash over the js reserved words
+ *
+ *  minify_js reads a whole identifier at a time and looks it up here,
+ *  the hash (first two bytes, last byte and length) maps every word
+ *  below to its own slot of a 128 entry table, so a lookup is one hash,
+ *  one load and one compare. to add a word append it to js_keyword_t
+ *  and js_keywords, the static_assert fails if the hash stops being
+ *  perfect (retune js_keyword_hash if it does)
+ */
+
+#ifndef MINIFY_JS_KEYWORDS_H
+#define MINIFY_JS_KEYWORDS_H
+
+#include <cstddef>
+#include <string.h>
+
+#include "char_class.h"
+
+namespace minify {
+	enum js_keyword_t : unsigned char {
+		kw_none,
+		kw_async,
+		kw_await,
+		kw_break,
+		kw_case,
+		kw_catch,
+		kw_class,
+		kw_const,
+		kw_continue,
+		kw_debugger,
+		kw_default,
+		kw_delete,
+		kw_do,
+		kw_else,
+		kw_enum,
+		kw_export,
+		kw_extends,
+		kw_false,
+		kw_finally,
+		kw_for,
+		kw_function,
+		kw_if,
+		kw_import,
+		kw_in,
+		kw_instanceof,
+		kw_let,
+		kw_new,
+		kw_null,
+		kw_of,
+		kw_return,
+		kw_static,
+		kw_super,
+		kw_switch,
+		kw_this,
+		kw_throw,
+		kw_true,
+		kw_try,
+		kw_typeof,
+		kw_var,
+		kw_void,
+		kw_while,
+		kw_with,
+		kw_yield,
+		kw_count
+	};
+
+	//how a keyword steers the statement and semicolon logic
+	enum js_keyword_flags_t : unsigned char {
+		kwf_condition = 1 << 0, //a bracketed condition follows, eg. if(..)
+		kwf_continues = 1 << 1, //a newline after it never ends the statement
+		kwf_ends      = 1 << 2  //a newline after it always ends the statement
+	};
+
+	struct js_keyword_info {
+		char const* word;
+		std::size_t length;
+		unsigned char flags;
+	};
+
+	static constexpr js_keyword_info js_keywords[kw_count] = {
+		{"",           0,  0},
+		{"async",      5,  0},
+		{"await",      5,  kwf_continues},
+		{"break",      5,  kwf_ends},
+		{"case",       4,  0},
+		{"catch",      5,  0},
+		{"class",      5,  0},
+		{"const",      5,  0},
+		{"continue",   8,  kwf_ends},
+		{"debugger",   8,  kwf_ends},
+		{"default",    7,  0},
+		{"delete",     6,  kwf_continues},
+		{"do",         2,  kwf_continues},
+		{"else",       4,  kwf_continues},
+		{"enum",       4,  0},
+		{"export",     6,  0},
+		{"extends",    7,  kwf_continues},
+		{"false",      5,  0},
+		{"finally",    7,  0},
+		{"for",        3,  0},
+		{"function",   8,  kwf_condition},
+		{"if",         2,  kwf_condition},
+		{"import",     6,  0},
+		{"in",         2,  kwf_continues},
+		{"instanceof", 10, kwf_continues},
+		{"let",        3,  0},
+		{"new",        3,  kwf_continues},
+		{"null",       4,  0},
+		{"of",         2,  0},
+		{"return",     6,  kwf_ends},
+		{"static",     6,  0},
+		{"super",      5,  0},
+		{"switch",     6,  0},
+		{"this",       4,  0},
+		{"throw",      5,  0},
+		{"true",       4,  0},
+		{"try",        3,  0},
+		{"typeof",     6,  kwf_continues},
+		{"var",        3,  0},
+		{"void",       4,  kwf_continues},
+		{"while",      5,  kwf_condition},
+		{"with",       4,  0},
+		{"yield",      5,  kwf_ends}
+	};
+
+	static constexpr std::size_t js_keyword_min_length = 2,
+	                             js_keyword_max_length = 10,
+	                             js_keyword_slots      = 128;
+
+	static constexpr std::size_t js_keyword_hash(
+		char const* word,
+		std::size_t const& length
+	) {
+		return (
+			(unsigned char) word[0] +
+			(unsigned char) word[1] +
+			(unsigned char) word[length-1]*30 +
+			length
+		) & (js_keyword_slots - 1);
+	}
+
+	static constexpr unsigned char js_keyword_in_slot(
+		std::size_t const& slot,
+		std::size_t const& kw = 1
+	) {
+		return (kw == kw_count)
+			? (unsigned char) kw_none
+			: (js_keyword_hash(js_keywords[kw].word, js_keywords[kw].length) == slot)
+				? (unsigned char) kw
+				: js_keyword_in_slot(slot, kw+1);
+	}
+
+	//every keyword has to land in a slot of its own
+	static constexpr bool js_keyword_hash_is_perfect(
+		std::size_t const& kw = 1
+	) {
+		return (kw == kw_count) || (
+			js_keyword_in_slot(js_keyword_hash(js_keywords[kw].word, js_keywords[kw].length)) == kw &&
+			js_keyword_hash_is_perfect(kw+1)
+		);
+	}
+
+	static_assert(
+		js_keyword_hash_is_perfect(),
+		"js_keyword_hash has collisions, retune it"
+	);
+
+	struct js_keyword_table {
+		unsigned char slots[js_keyword_slots];
+	};
+
+	template <std::size_t... I>
+	static constexpr js_keyword_table make_js_keyword_table(
+		index_list<I...>
+	) {
+		return js_keyword_table{{ js_keyword_in_slot(I)... }};
+	}
+
+	static constexpr js_keyword_table js_keyword_slots_table =
+		make_js_keyword_table(make_index_list<js_keyword_slots>::type());
+
+	//the keyword [word, word+length) spells, or kw_none
+	static inline js_keyword_t js_keyword(
+		char const* word,
+		std::size_t const& length
+	) {
+		if(length < js_keyword_min_length || length > js_keyword_max_length)
+			return kw_none;
+
+		unsigned char const kw = js_keyword_slots_table.slots[js_keyword_hash(word, length)];
+
+		return (
+			js_keywords[kw].length == length &&
+			!memcmp(js_keywords[kw].word, word, length)
+		) ? js_keyword_t(kw) : kw_none;
+	}
+}
+
+#endif //MINIFY_JS_KEYWORDS_H
@@ -1,4 +1,4 @@
-#include "mantis-minify.h"
+#include "cli.h"
 
 int main(int argc_int, char ** argv)
 {
@@ -7,6 +7,23 @@ int main(int argc_int, char ** argv)
 
 	exec_name.assign(argv[0]);
 
+	//known up front so nothing below prompts on what is the input
+	for(std::size_t a=1; a<argc; ++a)
+		if(!strcmp(argv[a], "-") || !strcmp(argv[a], "--stdin"))
+			stdin_mode = 1;
+
+	//the kernels ignore a level they do not know, a benchmark must not run on the wrong one
+	minify::simd::isa_t env_isa;
+	if(char const* env = getenv("MANTIS_MINIFY_ISA")) {
+		if(!minify::simd::isa_from_name(env, env_isa)) {
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "MANTIS_MINIFY_ISA expects one of scalar, sse2, avx2, avx512\r\n";
+
+			return 0;
+		}
+	}
+
 	while(++p < argc)
 	{
 		if(!strlen(argv[p]) || argv[p][0] != '-')
@@ -41,7 +58,14 @@ int main(int argc_int, char ** argv)
 			}
 
 
-			if(dir.length() && !dir_exists(dir.c_str())) {
+			if(dir.length() && !dir_exists(dir.c_str()) && stdin_mode) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "directory '" << dir << "' does not exist\r\n";
+
+				return 0;
+			}
+			else if(dir.length() && !dir_exists(dir.c_str())) {
 				std::cout << "directory '" << specified_output_path
 				          << "' does not exist, would you like to create it?"
 				          << std::endl;
@@ -91,7 +115,14 @@ int main(int argc_int, char ** argv)
 				);
 			}
 
-			if(specified_output_path.length() && !dir_exists(specified_output_path.c_str())) {
+			if(specified_output_path.length() && !dir_exists(specified_output_path.c_str()) && stdin_mode) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "directory '" << specified_output_path << "' does not exist\r\n";
+
+				return 0;
+			}
+			else if(specified_output_path.length() && !dir_exists(specified_output_path.c_str())) {
 				std::cout 
 					<< "directory '" << specified_output_path << "' does not exit\n"
 					<< "would you like to create it?\r\n";
@@ -146,6 +177,153 @@ int main(int argc_int, char ** argv)
 			param == "--raw-comments"
 		)
 			minify_comments = 0;
+		else if(
+			param == "--stream"
+		)
+			stream_mode = 1;
+		else if(
+			param == "-j" ||
+			param == "--jobs"
+		) {
+			long jobs;
+			char* end;
+
+			if(
+				++p >= argc ||
+				(jobs = strtol(argv[p], &end, 10)) < 1 ||
+				*end
+			) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "-j expects a number of threads above 0\r\n";
+
+				return 0;
+			}
+			no_jobs = jobs;
+		}
+		else if(
+			param == "--pin"
+		)
+			pin_workers = 1;
+		else if(
+			param == "--no-io-uring"
+		)
+			use_uring = 0;
+		else if(
+			param == "--watch"
+		)
+			watch_mode = 1;
+		else if(
+			param == "--daemon" ||
+			param == "--client"
+		) {
+			if(++p >= argc) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< param << " expects a socket path\r\n";
+
+				return 0;
+			}
+			((param == "--daemon") ? daemon_socket : client_socket).assign(argv[p]);
+		}
+		else if(
+			param == "--serve"
+		) {
+			if(++p >= argc) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--serve expects a directory\r\n";
+
+				return 0;
+			}
+			serve_dir.assign(argv[p]);
+		}
+		else if(
+			param == "--port"
+		) {
+			long port;
+			char* end;
+
+			if(
+				++p >= argc ||
+				(port = strtol(argv[p], &end, 10)) < 1 ||
+				port > 65535 ||
+				*end
+			) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--port expects a port number from 1 to 65535\r\n";
+
+				return 0;
+			}
+			serve_port = port;
+		}
+		else if(
+			param == "--cache"
+		) {
+			if(++p >= argc) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--cache expects a directory\r\n";
+
+				return 0;
+			}
+			cache_dir.assign(argv[p]);
+
+			if(!dir_exists(cache_dir) && (make_dir(cache_dir) || !dir_exists(cache_dir))) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "failed to create cache directory '" << cache_dir << "'\r\n";
+
+				return 0;
+			}
+		}
+		else if(
+			param == "--cost-history"
+		) {
+			if(++p >= argc) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--cost-history expects a file path\r\n";
+
+				return 0;
+			}
+			cost_history_path.assign(argv[p]);
+		}
+		else if(
+			param == "--ndjson"
+		) {
+			lang = lang_t::json;
+			ndjson_mode = 1;
+		}
+		else if(
+			param == "-" ||
+			param == "--stdin"
+		)
+			stdin_mode = 1;
+		else if(
+			param == "--cpu-features"
+		) {
+			minify::simd::isa_t isa;
+
+			if(
+				++p >= argc || 
+				!minify::simd::isa_from_name(argv[p], isa)
+			) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--cpu-features expects one of scalar, sse2, avx2, avx512\r\n";
+
+				return 0;
+			}
+			else if(!minify::simd::set_isa(isa)) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "this cpu does not support " << argv[p] << "\r\n";
+
+				return 0;
+			}
+		}
 		else if(
 			param == "-v" || 
 			param == "--version"
@@ -176,9 +354,11 @@ int main(int argc_int, char ** argv)
 
 				<< "=> examples:\n"
 				<< "  | " << exec_name << " *.css\n"
-				<< "  | " << exec_name << " --output-path bundled.min.css *.css\n\n"
+				<< "  | " << exec_name << " --output-path bundled.min.css *.css\n"
+				<< "  | cat *.json | " << exec_name << " --json -\n\n"
 
 				<< "=> options:\n"
+				<< "  (without one of these each file goes by its extension, else its content)\n"
 				<< "  -css,  --css\n"
 				<< "    minify css\n"
 				<< "  -html, --html\n"
@@ -187,6 +367,8 @@ int main(int argc_int, char ** argv)
 				<< "    minify js\n"
 				<< "  -json, --json\n"
 				<< "    minify json\n"
+				<< "      --ndjson\n"
+				<< "    minify json lines, one record per line, on all cores\n"
 				<< "  -d, --directory, --dir <DIR>\n"
 				<< "    output to <DIR> as *.min.css\n"
 				<< "  -o, --output-path <PATH>\n"
@@ -197,6 +379,33 @@ int main(int argc_int, char ** argv)
 				<< "    keep /*! .. */ comments\n"
 				<< "      --raw-comments\n"
 				<< "    unminified comments\n"
+				<< "      --stream\n"
+				<< "    minify css/json a block at a time in constant memory\n"
+				<< "  -, --stdin\n"
+				<< "    minify standard input as it arrives (needs a language)\n"
+				<< "  -j, --jobs <N>\n"
+				<< "    use up to N threads (default: cpus allowed by affinity and cgroup quota)\n"
+				<< "      --pin\n"
+				<< "    pin each worker thread to its own cpu\n"
+				<< "      --cost-history <PATH>\n"
+				<< "    order work by how long each file took last time\n"
+				<< "      --watch\n"
+				<< "    minify again each time an input changes (needs -d or -o)\n"
+				<< "      --daemon <SOCKET>\n"
+				<< "    serve minify requests on a unix socket with one pool of threads\n"
+				<< "      --client <SOCKET>\n"
+				<< "    forward to the daemon at <SOCKET> (minifies here if there is none)\n"
+				<< "      --serve <DIR>\n"
+				<< "    serve <DIR> over http on localhost, minified on first request\n"
+				<< "      --port <N>\n"
+				<< "    the port --serve listens on (default: 8080)\n"
+				<< "      --cache <DIR>\n"
+				<< "    reuse outputs of unchanged files from <DIR> (shared between runs)\n"
+				<< "      --no-io-uring\n"
+				<< "    read and write batches of small files a file at a time\n"
+				<< "      --cpu-features <LEVEL>\n"
+				<< "    cap vector instructions at scalar|sse2|avx2|avx512\n"
+				<< "    (also MANTIS_MINIFY_ISA)\n"
 				<< "  -v, --version\n"
 				<< "    version installed\r\n";
 
@@ -213,6 +422,72 @@ int main(int argc_int, char ** argv)
 		}
 	}
 
+	if(ndjson_mode && stream_mode) {
+		std::cout 
+			<< "error: " << exec_name << ": "
+			<< "--ndjson and --stream can not be used together\r\n";
+
+		return 0;
+	}
+
+	if(!no_jobs)
+		no_jobs = minify::available_cpus();
+
+	if(stdin_mode) {
+		if(p < argc) {
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "stdin can not be mixed with source files\r\n";
+
+			return 0;
+		}
+		else if(lang == lang_t::unspecified) {
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "stdin needs one of --css, --html, --js, --json\r\n";
+
+			return 0;
+		}
+		else if(output_type == output_t::directory) {
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "stdin has no file name, use --output-path instead of --directory\r\n";
+
+			return 0;
+		}
+
+		if(ndjson_mode)
+			minify_ndjson();
+		else
+			minify_piped();
+
+		return 0;
+	}
+
+	if(serve_dir.length()) {
+		#ifdef MINIFY_HAS_DAEMON
+			minify_served(serve_dir.c_str());
+		#else
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "--serve is not supported on this platform\r\n";
+		#endif
+
+		return 0;
+	}
+
+	if(daemon_socket.length()) {
+		#ifdef MINIFY_HAS_DAEMON
+			minify_daemon(daemon_socket.c_str());
+		#else
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "--daemon is not supported on this platform\r\n";
+		#endif
+
+		return 0;
+	}
+
 	if(p >= argc) {
 		std::cout << "no files specified, nothing to do" << std::endl;
 		return 0;
@@ -222,32 +497,53 @@ int main(int argc_int, char ** argv)
 		to_minify.push_back(argv[p]);
 	}while(++p < argc);
 
-	minified_vec = std::vector<char*>(to_minify.size());
+	if(ndjson_mode) {
+		minify_ndjson();
 
-	std::size_t no_cores = std::thread::hardware_concurrency();
-	std::vector<std::thread> thrds;
+		return 0;
+	}
 
-	for(std::size_t c=0; c<no_cores; ++c) 
-		thrds.push_back(std::thread(minify_thrd));
-	for(std::size_t c=0; c<no_cores; ++c)
-		thrds[c].join();
+	if(stream_mode) {
+		if(lang != lang_t::unspecified && lang != lang_t::css && lang != lang_t::json) {
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "--stream supports css and json\r\n";
+
+			return 0;
+		}
 
+		minify_streamed();
 
-	if(output_type == output_t::terminal) {
-		for(std::size_t m=0; m<minified_vec.size(); ++m)
-			std::cout << minified_vec[m];
-		std::cout << std::endl;
+		return 0;
 	}
-	else if(output_type == output_t::file) {
-		FILE* f = fopen(specified_output_path.c_str(), "w");
-		for(std::size_t m=0; m<minified_vec.size(); ++m)
-			fputs(minified_vec[m], f);
-		fclose(f);
+
+	//without a daemon to forward to the inputs are minified here as usual
+	#ifdef MINIFY_HAS_DAEMON
+		if(client_socket.length() && !watch_mode && minify_client(client_socket.c_str()))
+			return 0;
+	#endif
+
+	if(watch_mode) {
+		#ifdef __linux__
+			if(output_type == output_t::terminal) {
+				std::cout 
+					<< "error: " << exec_name << ": "
+					<< "--watch needs -d or -o\r\n";
+
+				return 0;
+			}
+
+			minify_watched();
+		#else
+			std::cout 
+				<< "error: " << exec_name << ": "
+				<< "--watch is only supported on linux\r\n";
+		#endif
+
+		return 0;
 	}
 
-	for(std::size_t m=0; m<minified_vec.size(); ++m)
-		free(minified_vec[m]);
-	minified_vec.clear();
+	minify_scheduled(no_jobs);
 
 	return 0;
 }
@@ -1,4 +1,4 @@
-#include "mantis-minify.h"
+#include "cli.h"
 
 #include <emscripten.h>
 
@@ -226,25 +226,9 @@ int main(int argc_int, char ** argv)
 		to_minify.push_back(argv[p]);
 	}while(++p < argc);
 
-	minified_vec = std::vector<char*>(to_minify.size());
-
-	minify_thrd();
-
-	if(output_type == output_t::terminal) {
-		for(std::size_t m=0; m<minified_vec.size(); ++m)
-			std::cout << minified_vec[m];
-		std::cout << std::endl;
-	}
-	else if(output_type == output_t::file) {
-		FILE* f = fopen(specified_output_path.c_str(), "w");
-		for(std::size_t m=0; m<minified_vec.size(); ++m)
-			fputs(minified_vec[m], f);
-		fclose(f);
-	}
-
-	for(std::size_t m=0; m<minified_vec.size(); ++m)
-		free(minified_vec[m]);
-	minified_vec.clear();
+	//no threads under emscripten, the calling thread is the one worker
+	no_jobs = 1;
+	minify_scheduled(no_jobs);
 
 	return 0;
 }
@@ -14,6 +14,10 @@
 #include <iostream>
 
 #include "string.h"
+#include "char_class.h"
+#include "js_keywords.h"
+#include "simd.h"
+#include "stream.h"
 
 static constexpr char const* version = "v0.2";
 
@@ -54,91 +58,43 @@ static constexpr char quote_marks[3] = {
 static constexpr bool is_whitespace(
     char const& c
 ) {
-	return (
-		c == ' '  ||
-		c == '\t' ||
-		c == '\n' ||
-		c == '\r'
-	);
+	return minify::char_class(c) & minify::cc_whitespace;
 }
 
 static constexpr bool is_inline_whitespace(
     char const& c
 ) {
-	return (
-		c == ' '  ||
-		c == '\t'
-	);
+	return minify::char_class(c) & minify::cc_inline_whitespace;
 }
 
 static constexpr bool is_open_brace(
     char const& c
 ) {
-	return (
-		c == '{'  ||
-		c == '('  ||
-		c == '['  /*||
-		c == '<'*/
-	);
+	return minify::char_class(c) & minify::cc_open_brace;
 }
 
 static constexpr bool is_close_brace(
     char const& c
 ) {
-	return (
-		c == '}'  ||
-		c == ')'  ||
-		c == ']'  /*||
-		c == '>'*/
-	);
+	return minify::char_class(c) & minify::cc_close_brace;
 }
 
 static constexpr bool is_quote_mark(
     char const& c
 ) {
-	return (
-		c == quote_marks[0] ||
-		c == quote_marks[1] ||
-		c == quote_marks[2]
-	);
+	return minify::char_class(c) & minify::cc_quote;
 }
 
 static constexpr bool is_special_css_selector_char(
 	char const& c
 ) {
-	return (
-		c == ',' ||
-		c == '{' ||
-		c == ')' ||
-		c == '>' ||
-		c == '+' ||
-		c == '~' ||
-		c == '"' ||
-		c == '\''
-	);
+	return minify::char_class(c) & minify::cc_css_selector;
 }
 
 static constexpr bool is_special_css_property_char(
 	char const& c
 ) {
-	return (
-		c == ',' ||
-		c == '{' ||
-		c == ')' ||
-		c == '>' ||
-		c == '+' ||
-		c == '~' ||
-		c == '}' ||
-		c == ':' ||
-		c == '!' ||
-		c == '#' ||
-		c == '*' ||
-		c == '=' ||
-		c == '(' ||
-		c == '[' ||
-		c == ']' ||
-		c == '<'
-	);
+	return minify::char_class(c) & minify::cc_css_property;
 }
 
 static constexpr bool is_js_eol_char(
@@ -146,23 +102,14 @@ static constexpr bool is_js_eol_char(
 	char const& c
 ) {
 	return !(
-		c == '{'  ||
-		c == '['  ||
-		c == '('  ||
-		c == '<'  ||
-		c == '='  ||
-		(c == '+' && p != '+')  ||
-		(c == '-' && p != '-')  ||
-		(c == '*' && p != '/')  ||
-		(c == '/' && p != '/' && p != '*')  ||
-		c == '|'  ||
-		c == '&'  ||
-		c == '?'  ||
-		c == '.'  ||
-		c == ','  ||
-		c == ':'  ||
-		c == '%'  ||
-		c == '\\' 
+		(minify::char_class(c) & minify::cc_js_continues) || (
+			(minify::char_class(c) & minify::cc_js_operator) && !(
+				(c == '+' && p == '+') ||
+				(c == '-' && p == '-') ||
+				(c == '*' && p == '/') ||
+				(c == '/' && (p == '/' || p == '*'))
+			)
+		)
 	);
 }
 
@@ -170,26 +117,23 @@ static constexpr bool is_js_newline_char(
 	char const& c,
 	char const& n
 ) {
-	return is_js_eol_char(n, c) && !(
-		c == '}' ||
-		c == ')' ||
-		c == ']' ||
-		c == '>'
-	);
+	return is_js_eol_char(n, c) && 
+		!(minify::char_class(c) & minify::cc_js_closes);
 }
 
 static constexpr bool is_special_char(
 	char const& c
 ) {
-	return !(
-		('0' <= c && c <= '9') ||
-		('a' <= c && c <= 'z') ||
-		('A' <= c && c <= 'Z') ||
-		c == '_'
-	);
+	return !(minify::char_class(c) & minify::cc_word);
 }
 
-void skip_past_raw_comment(
+static constexpr bool is_js_identifier_char(
+	char const& c
+) {
+	return minify::char_class(c) & minify::cc_js_identifier;
+}
+
+inline void skip_past_raw_comment(
     minify::type::string const& code,
     std::size_t& comment_depth,
     std::ptrdiff_t& pos_code
@@ -197,18 +141,28 @@ void skip_past_raw_comment(
 	if(pos_code + 3 < code.size()) {
         if(code[pos_code] == slash) {
             if(code[++pos_code] == slash) {
-                ++pos_code;
-                while(
-                    pos_code < code.size() &&
-                    code[pos_code] != newline
-                )
-                    ++pos_code;
-                ++pos_code;
+                pos_code = minify::simd::find_char(
+                	code.c_str(),
+                	pos_code + 1,
+                	code.size(),
+                	newline
+                );
+                if(pos_code < code.size())
+                	++pos_code;
             }
             else if(code[pos_code] == asterix) {
                 ++comment_depth;
                 ++(++pos_code);
-                while(pos_code < code.size()) {
+                //only a '/' or '*' can complete an opener or terminator
+                while(
+                	(pos_code = minify::simd::find_either(
+                		code.c_str(),
+                		pos_code,
+                		code.size(),
+                		slash,
+                		asterix
+                	)) < code.size()
+                ) {
                     if(
                         code[pos_code-1] == slash   && 
                         code[pos_code]   == asterix && 
@@ -229,12 +183,12 @@ void skip_past_raw_comment(
     }
 }
 
-void skip_past_html_comment(
+inline void skip_past_html_comment(
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
 	if(
-		pos_code + 6 < code.size() &&
+		pos_code + 3 < code.size() &&
 			code[pos_code] == '<' &&
 			code[pos_code+1] == '!' &&
 			code[pos_code+2] == '-' &&
@@ -242,17 +196,26 @@ void skip_past_html_comment(
 	) {
 		pos_code += 6;
 
-		while(!(
-			code[pos_code-2] == '-' &&
-			code[pos_code-1] == '-' &&
-			code[pos_code]   == '>'
-		)) 
+		//unterminated comments run to the end of the input
+		while(
+			(pos_code = minify::simd::find_char(
+				code.c_str(),
+				pos_code,
+				code.size(),
+				'>'
+			)) < code.size() && !(
+				code[pos_code-2] == '-' &&
+				code[pos_code-1] == '-'
+			)
+		) 
+			++pos_code;
+
+		if(pos_code < code.size())
 			++pos_code;
-		++pos_code;
 	}
 }
 
-void cpy_comment(
+inline void cpy_comment(
 	minify::type::string const& code,
 	std::size_t& comment_depth,
 	std::ptrdiff_t const& pos_begin,
@@ -266,7 +229,7 @@ void cpy_comment(
 		pos_code
 	);
 
-	memcpy(
+	memmove(
 		&cpy[cpy_pos], 
 		&code[pos_begin], 
 		pos_code-pos_begin
@@ -274,7 +237,7 @@ void cpy_comment(
 	cpy_pos += pos_code-pos_begin-1;
 }
 
-void cpy_html_comment(
+inline void cpy_html_comment(
 	minify::type::string const& code,
 	std::ptrdiff_t const& pos_begin,
 	std::ptrdiff_t& pos_code,
@@ -286,7 +249,7 @@ void cpy_html_comment(
 		pos_code
 	);
 
-	memcpy(
+	memmove(
 		&cpy[cpy_pos], 
 		&code[pos_begin], 
 		pos_code-pos_begin
@@ -294,7 +257,7 @@ void cpy_html_comment(
 	cpy_pos += pos_code-pos_begin-1;
 }
 
-void skip_past_zeros(
+inline void skip_past_zeros(
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
@@ -305,7 +268,7 @@ void skip_past_zeros(
 		++pos_code;
 }
 
-void skip_past_whitespace(
+inline void skip_past_whitespace(
 	lang_t const& lang,
     minify::type::string const& code,
     std::size_t& comment_depth,
@@ -316,7 +279,11 @@ void skip_past_whitespace(
 		pos_code < code.size()
 	) {
 		if(is_whitespace(code[pos_code]))
-			++pos_code;
+			pos_code = minify::simd::skip_whitespace(
+				code.c_str(),
+				pos_code + 1,
+				code.size()
+			);
 		else if(
 			comment_mode != comment_mode_t::keep &&
 			lang != lang_t::html &&
@@ -369,7 +336,7 @@ void skip_past_whitespace(
 	}
 }
 
-void skip_past_inline_whitespace(
+inline void skip_past_inline_whitespace(
     minify::type::string const& code,
     std::size_t& comment_depth,
     std::ptrdiff_t& pos_code,
@@ -379,7 +346,12 @@ void skip_past_inline_whitespace(
 		pos_code < code.size()
 	) {
 		if(is_inline_whitespace(code[pos_code]))
-			++pos_code;
+			pos_code = minify::simd::skip_whitespace(
+				code.c_str(),
+				pos_code + 1,
+				code.size(),
+				1
+			);
 		else if(
 			comment_mode != comment_mode_t::keep &&
 			pos_code+3 < code.size()    &&
@@ -416,20 +388,24 @@ void skip_past_inline_whitespace(
 	}
 }
 
-void skip_to_quote_end(
+inline void skip_to_quote_end(
 	char const& quote_char,
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
-	while(
-		++pos_code < code.size() && 
-		code[pos_code] != quote_char
-	)
-		if(code[pos_code] == escape)
-			++pos_code;
+	//an unterminated literal runs to the last character, not onto the terminator
+	pos_code = std::min(
+		minify::simd::find_quote_end(
+			code.c_str(),
+			pos_code + 1,
+			code.size(),
+			quote_char
+		),
+		code.size() - 1
+	);
 }
 
-void skip_past_quote(
+inline void skip_past_quote(
 	char const& quote_char,
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
@@ -442,7 +418,7 @@ void skip_past_quote(
 	++pos_code;
 }
 
-void skip_past_pre_block(
+inline void skip_past_pre_block(
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
@@ -455,28 +431,29 @@ void skip_past_pre_block(
 	++pos_code;
 }
 
-void skip_to_regex_end(
+inline void skip_to_regex_end(
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
 	skip_to_quote_end('/', code, pos_code);
 }
 
-void skip_past_regex(
+inline void skip_past_regex(
     minify::type::string const& code,
     std::ptrdiff_t& pos_code
 ) {
 	skip_past_quote('/', code, pos_code);
 }
 
-void cpy_between(
+inline void cpy_between(
 	minify::type::string const& code,
 	std::ptrdiff_t const& pos_begin,
 	std::ptrdiff_t const& pos_end,
 	minify::type::string& cpy,
 	std::ptrdiff_t& cpy_pos
 ) {
-	memcpy(
+	//code and cpy are the same string when minifying in place
+	memmove(
 		&cpy[cpy_pos], 
 		&code[pos_begin], 
 		pos_end-pos_begin + 1
@@ -484,7 +461,7 @@ void cpy_between(
 	cpy_pos += pos_end-pos_begin;
 }
 
-void cpy_quote(
+inline void cpy_quote(
 	char const& quote_char,
     minify::type::string const& code,
     std::ptrdiff_t const& pos_begin,
@@ -507,7 +484,7 @@ void cpy_quote(
 	);
 }
 
-void cpy_regex(
+inline void cpy_regex(
     minify::type::string const& code,
     std::ptrdiff_t const& pos_begin,
     std::ptrdiff_t& pos_code,
@@ -528,7 +505,7 @@ void cpy_regex(
 	);
 }
 
-void cpy_pre_block(
+inline void cpy_pre_block(
     minify::type::string const& code,
     std::ptrdiff_t const& pos_begin,
     std::ptrdiff_t& pos_code,
@@ -549,7 +526,7 @@ void cpy_pre_block(
 	);
 }
 
-void minify_css(
+inline void minify_css(
 	minify::type::string const& css,
 	ptrdiff_t& pos_css,
 	minify::type::string& minified,
@@ -562,7 +539,6 @@ void minify_css(
 	std::size_t comment_depth = 0,
 	            curly_bracket_depth = 0;
 	std::ptrdiff_t pos_begin;
-	minify::type::string cstr;
 
 	if(minified.capacity() <= css.length())
 		minified.strict_resize(css.length()+1);
@@ -720,11 +696,8 @@ void minify_css(
 				minified[++pos_minified] = semicolon;
 		}
 		else if(css[pos_css] == angle_open) {
-			cstr.substr(css, pos_css, 7);
-			if(cstr == "</style") {
-				css[pos_css] = '\0';
+			if(css.view(pos_css, 7) == "</style")
 				break; //return;
-			}
 
 			minified[++pos_minified] = angle_open;
 			++pos_css;
@@ -742,7 +715,7 @@ void minify_css(
 		minified.strict_resize(pos_minified);
 }
 
-void minify_css(
+inline void minify_css(
 	minify::type::string const& css,
 	minify::type::string& minified,
 	bool const& minify_comments = 1,
@@ -761,7 +734,7 @@ void minify_css(
 	);
 }
 
-void minify_css(
+inline void minify_css(
 	minify::type::string& css,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
@@ -781,7 +754,7 @@ void minify_css(
 
 #include <vector>
 
-void minify_js(
+inline void minify_js(
 	minify::type::string const& js,
 	ptrdiff_t& pos_js,
 	minify::type::string& minified,
@@ -793,6 +766,8 @@ void minify_js(
 	bool inside_comment = 0, 
 	     treat_round_close_as_eol = 1,
 	     was_semicolon;
+	unsigned char keyword_flags;
+	minify::js_keyword_t keyword = minify::kw_none;
 	char quote_type, 
 	     prev_non_whitespace_chr = ';', 
 	     prev_chr = ' ', 
@@ -801,9 +776,17 @@ void minify_js(
 	            round_bracket_depth = 0,
 	            bracket_depth = 0;
 	std::ptrdiff_t pos_begin,
-	               pos_prev_non_whitespace = -1;
-	minify::type::string cstr;
-	std::vector<std::size_t> is_eq_statement(1, std::size_t(0));
+	               pos_prev_non_whitespace = -1,
+	               pos_keyword = -1;
+	minify::type::arena_scope scratch(minify::type::scratch_arena());
+	std::vector<
+		std::size_t, 
+		minify::type::arena_allocator<std::size_t>
+	> is_eq_statement(
+		1, 
+		std::size_t(0), 
+		minify::type::arena_allocator<std::size_t>(minify::type::scratch_arena())
+	);
 
 	if(minified.capacity() <= js.length())
 		minified.strict_resize(js.length()+1);
@@ -830,7 +813,7 @@ void minify_js(
 			if(is_eq_statement.size() <= bracket_depth)
 				is_eq_statement.push_back(0);
 		}
-		else if(is_close_brace(js[pos_js]))
+		else if(is_close_brace(js[pos_js]) && bracket_depth) //unbalanced code must not index below 0
 			--bracket_depth;
 
 		if(
@@ -895,8 +878,8 @@ void minify_js(
 			);
 
 			if(
-				!is_special_char(js[pos_js]) &&
-				!is_special_char(prev_non_whitespace_chr)
+				is_js_identifier_char(js[pos_js]) &&
+				is_js_identifier_char(prev_non_whitespace_chr)
 			)
 				minified[++pos_minified] = space;
 		}
@@ -931,6 +914,9 @@ void minify_js(
 
 			prev_chr = (pos_prev_non_whitespace) ? js[pos_prev_non_whitespace-1] : ' ';
 			next_chr = (pos_js+1 < js.size()) ? js[pos_js+1] : ' ';
+			keyword_flags = (pos_prev_non_whitespace == pos_keyword)
+				? minify::js_keywords[keyword].flags
+				: 0;
 			
 			if((
 				was_semicolon && (
@@ -938,8 +924,12 @@ void minify_js(
 					prev_non_whitespace_chr == ')'   // {while(condition);}
 			)) || (
 				pos_js < js.size() &&
-				is_js_eol_char(prev_chr, prev_non_whitespace_chr) &&
-				is_js_newline_char(js[pos_js], next_chr)
+				!(keyword_flags & minify::kwf_continues) && (
+					(keyword_flags & minify::kwf_ends) || ( //eg. return\n(x)
+						is_js_eol_char(prev_chr, prev_non_whitespace_chr) &&
+						is_js_newline_char(js[pos_js], next_chr)
+					)
+				)
 			)) {
 				if((
 					is_eq_statement[bracket_depth] || 
@@ -951,6 +941,12 @@ void minify_js(
 				)))
 					minified[++pos_minified] = semicolon;
 			}
+			else if(
+				pos_js < js.size() &&
+				is_js_identifier_char(js[pos_js]) &&
+				is_js_identifier_char(prev_non_whitespace_chr)
+			)
+				minified[++pos_minified] = space; //eg. typeof\nx
 			is_eq_statement[bracket_depth] = 0;
 		}
 		else if(
@@ -1036,8 +1032,7 @@ void minify_js(
 			)
 		) {
 			if(js[pos_js] == angle_open) {
-				cstr.substr(js, pos_js, 8);
-				if(cstr == "</script") 
+				if(js.view(pos_js, 8) == "</script")
 					return; //break;
 			}
 			else if(
@@ -1062,87 +1057,33 @@ void minify_js(
 				comment_mode
 			);
 		}
-		else if(
-			pos_js+1 < js.size() &&
-			js[pos_js]   == 'i'  && 
-			js[pos_js+1] == 'f'
-		) {
-			treat_round_close_as_eol = 0;
-			minified[++pos_minified] = js[pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			++pos_js;
-		}
-		else if(
-			pos_js+2 < js.size() &&
-			js[pos_js]   == 'f'  && 
-			js[pos_js+1] == 'o'  &&
-			js[pos_js+2] == 'r'
-		) {
-			//treat_round_close_as_eol = 1;
-			minified[++pos_minified] = js[pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			++pos_js;
-		}
-		else if(
-			pos_js+4 < js.size() &&
-			js[pos_js]   == 'w'  && 
-			js[pos_js+1] == 'h'  &&
-			js[pos_js+2] == 'i'  &&
-			js[pos_js+3] == 'l'  &&
-			js[pos_js+4] == 'e'
-		) {
-			treat_round_close_as_eol = 0;
-			minified[++pos_minified] = js[pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			++pos_js;
-		}
-		else if(
-			pos_js+7 < js.size() &&
-			js[pos_js]   == 'f'  && 
-			js[pos_js+1] == 'u'  &&
-			js[pos_js+2] == 'n'  &&
-			js[pos_js+3] == 'c'  &&
-			js[pos_js+4] == 't'  &&
-			js[pos_js+5] == 'i'  &&
-			js[pos_js+6] == 'o'  &&
-			js[pos_js+7] == 'n'
-		) {
-			treat_round_close_as_eol = 0;
-			minified[++pos_minified] = js[pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			++pos_js;
-		}
-		else if(
-			pos_js+3 < js.size() &&
-			js[pos_js]   == 'e'  && 
-			js[pos_js+1] == 'l'  &&
-			js[pos_js+2] == 's'  &&
-			js[pos_js+3] == 'e'
-		) {
-			//treat_round_close_as_eol = 0;
-			minified[++pos_minified] = js[pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			minified[++pos_minified] = js[++pos_js];
-			
-			skip_past_whitespace(
-				lang_t::js,
-				js, 
-				comment_depth,
-				++pos_js, 
-				comment_mode
+		else if(is_js_identifier_char(js[pos_js])) {
+			pos_begin = pos_js;
+			while(
+				++pos_js < js.size() && 
+				is_js_identifier_char(js[pos_js])
 			);
+
+			//a.if is a property, not a keyword. classified before the copy
+			//as in place minification may overwrite the identifier
+			keyword = (prev_chr == '.') 
+				? minify::kw_none 
+				: minify::js_keyword(&js[pos_begin], pos_js - pos_begin);
+
+			cpy_between(
+				js,
+				pos_begin,
+				pos_js-1,
+				minified,
+				++pos_minified
+			);
+
+			if(keyword) {
+				pos_keyword = pos_js-1;
+
+				if(minify::js_keywords[keyword].flags & minify::kwf_condition)
+					treat_round_close_as_eol = 0;
+			}
 		}
 		else {
 			minified[++pos_minified] = js[pos_js];
@@ -1157,7 +1098,36 @@ void minify_js(
 		minified.strict_resize(pos_minified);
 }
 
-void minify_js(
+/*
+ *  minify_js stops at a </script for minify_html to carry on from. a
+ *  script that is not in a page keeps what follows it as it is
+ */
+inline void finish_js_at_script_end(
+	minify::type::string const& js,
+	ptrdiff_t const& pos_js,
+	minify::type::string& minified,
+	ptrdiff_t& pos_minified,
+	bool const& minify_capacity
+) {
+	if(pos_js >= js.size())
+		return;
+
+	cpy_between(
+		js,
+		pos_js,
+		js.size()-1,
+		minified,
+		++pos_minified
+	);
+
+	minified[++pos_minified] = '\0';
+	minified.length(pos_minified);
+
+	if(minify_capacity)
+		minified.strict_resize(pos_minified);
+}
+
+inline void minify_js(
 	minify::type::string const& js,
 	minify::type::string& minified,
 	bool const& minify_comments = 1,
@@ -1174,9 +1144,10 @@ void minify_js(
 		comment_mode,
 		minify_capacity
 	);
+	finish_js_at_script_end(js, pos_js, minified, pos_minified, minify_capacity);
 }
 
-void minify_js(
+inline void minify_js(
 	minify::type::string& js,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
@@ -1192,24 +1163,340 @@ void minify_js(
 		comment_mode,
 		minify_capacity
 	);
+	finish_js_at_script_end(js, pos_js, js, pos_minified, minify_capacity);
+}
+
+inline void minify_json(
+	minify::type::string& json,
+	bool const& minify_comments,
+	comment_mode_t const& comment_mode,
+	bool const& minify_capacity
+);
+
+//inline blocks at least this large in total are minified on several threads
+static std::ptrdiff_t const inline_parallel_threshold = 1 << 16;
+
+/*
+ *  the body of a <script> or <style>, set aside by minify_html to be
+ *  minified apart from the page. lang_t::unspecified bodies (eg. html
+ *  templates) are copied as they are
+ */
+struct inline_block {
+	lang_t lang;
+	std::ptrdiff_t pos_minified, //where it goes in the minified page
+	               pos_source,   //where it starts in the set aside sources
+	               length;
+};
+
+//whether the tag name just read ends at pos
+inline bool is_tag_name_end(
+	minify::type::string const& html,
+	std::ptrdiff_t const& pos
+) {
+	return (
+		pos < html.size() && (
+			is_whitespace(html[pos]) ||
+			html[pos] == angle_close ||
+			html[pos] == slash
+		)
+	);
+}
+
+//where the closing tag from pos is, or the end of code if there is none
+inline std::ptrdiff_t find_closing_tag(
+	minify::type::string const& code,
+	std::ptrdiff_t pos,
+	minify::type::string_view const& tag
+) {
+	while(
+		(pos = minify::simd::find_char(code.c_str(), pos, code.size(), angle_open)) < code.size() &&
+		code.view(pos, tag.length()) != tag
+	)
+		++pos;
+
+	return pos;
+}
+
+/*
+ *  what a script holds going by the type attribute in its open tag, as
+ *  written to [pos, end) of minified (whose length is not set yet)
+ */
+inline lang_t inline_script_lang(
+	minify::type::string const& tag,
+	std::ptrdiff_t pos,
+	std::ptrdiff_t const& end
+) {
+	for(; pos + 5 < end; ++pos) {
+		if(
+			is_whitespace(tag[pos]) &&
+			minify::type::string_view(&tag[pos+1], 5) == "type="
+		) {
+			std::ptrdiff_t begin = pos + 6,
+			               length = 0;
+			char const quote = is_quote_mark(tag[begin]) ? tag[begin++] : 0;
+
+			while(
+				begin + length < end && (
+					quote ? tag[begin+length] != quote
+					      : !is_whitespace(tag[begin+length]) && tag[begin+length] != angle_close
+				)
+			)
+				++length;
+
+			minify::type::string_view const type(&tag[begin], length);
+
+			if(
+				!type.length() ||
+				type == "module" ||
+				type.contains("javascript") ||
+				type.contains("ecmascript")
+			)
+				return lang_t::js;
+			else if(type.contains("json"))
+				return lang_t::json;
+			return lang_t::unspecified;
+		}
+	}
+
+	return lang_t::js;
+}
+
+/*
+ *  the language a file holds going by its extension (.css, .js, .mjs,
+ *  .cjs, .json, .html or .htm in any case), unspecified for anything else
+ */
+inline lang_t path_lang(char const* path) {
+	char const* ext = nullptr;
+	for(char const* c = path; *c; ++c) {
+		if(*c == '.')
+			ext = c + 1;
+		else if(*c == '/' || *c == '\\')
+			ext = nullptr;
+	}
+
+	char lower[8] = {};
+	for(std::size_t c=0; ext && ext[c]; ++c) {
+		if(c + 1 >= sizeof(lower))
+			return lang_t::unspecified;
+		lower[c] = (ext[c] >= 'A' && ext[c] <= 'Z') ? ext[c] + ('a' - 'A') : ext[c];
+	}
+
+	minify::type::string_view const name(lower, strlen(lower));
+
+	if(name == "css")
+		return lang_t::css;
+	if(name == "js" || name == "mjs" || name == "cjs")
+		return lang_t::js;
+	if(name == "json")
+		return lang_t::json;
+	if(name == "html" || name == "htm")
+		return lang_t::html;
+	return lang_t::unspecified;
+}
+
+/*
+ *  the language text looks to hold going by how it starts, past any byte
+ *  order mark, whitespace and comments, for files whose extension does
+ *  not say. unspecified when it can not tell
+ */
+inline lang_t sniff_lang(
+	char const* text,
+	std::ptrdiff_t const& length
+) {
+	static minify::type::string_view const js_words[] = {
+		"import", "export", "const", "let", "var", "function", "class",
+		"async", "if", "for", "while", "return", "window", "document",
+		"module", "require", "self", "this", "new", "try", "switch"
+	};
+
+	char const* p = text;
+	char const* const end = text + length;
+
+	if(end - p >= 3 && minify::type::string_view(p, 3) == "\xEF\xBB\xBF")
+		p += 3;
+
+	for(;;) {
+		while(p < end && is_whitespace(*p))
+			++p;
+
+		if(end - p >= 2 && p[0] == '/' && p[1] == '*') {
+			char const* close = p + 2;
+			while(close + 1 < end && !(close[0] == '*' && close[1] == '/'))
+				++close;
+			//an unterminated comment runs to the end
+			p = (close + 1 < end) ? close + 2 : end;
+		}
+		else
+			break;
+	}
+
+	if(p >= end)
+		return lang_t::unspecified;
+
+	minify::type::string_view const rest(p, std::min<std::ptrdiff_t>(end - p, 12));
+
+	if(*p == '<')
+		return lang_t::html;
+	if(*p == '@')
+		return lang_t::css; //an at-rule
+	if(rest.starts_with("//") || rest.starts_with("#!") || *p == '(' || *p == '!' || *p == ';')
+		return lang_t::js;
+	if(rest.starts_with("\"use strict") || rest.starts_with("'use strict"))
+		return lang_t::js;
+
+	//an object or array of values, css selectors may start [attr] too
+	if(*p == '{' || *p == '[') {
+		char const* q = p + 1;
+		while(q < end && is_whitespace(*q))
+			++q;
+
+		if(q == end || *q == '"' || *q == '{' || *q == '[' || *q == '-' || (*q >= '0' && *q <= '9') ||
+		   *q == ((*p == '{') ? '}' : ']'))
+			return lang_t::json;
+		if(*p == '{')
+			return lang_t::js; //a block
+	}
+
+	char const* word = p;
+	while(word < end && is_js_identifier_char(*word))
+		++word;
+
+	for(std::size_t w=0; w<sizeof(js_words)/sizeof(js_words[0]); ++w)
+		if(minify::type::string_view(p, word - p) == js_words[w])
+			return lang_t::js;
+
+	//selectors up to a brace, then a declaration (name:) or an empty rule
+	char const* q = p;
+	for(int brackets=0; q < end && (brackets || (*q != '{' && *q != ';' && *q != '=')); ++q) {
+		if(!brackets && *q == ')')
+			return lang_t::unspecified;
+
+		//only a pseudo-class takes an argument, eg. :not(.a), anything else is a call
+		if(!brackets && *q == '(') {
+			char const* name = q;
+			while(name > p && (is_js_identifier_char(name[-1]) || name[-1] == '-'))
+				--name;
+			if(name == q || name == p || name[-1] != ':')
+				return lang_t::unspecified;
+
+			for(int depth=0; q < end; ++q)
+				if(!(depth += (*q == '(') - (*q == ')')))
+					break;
+			if(q == end)
+				return lang_t::unspecified;
+			continue;
+		}
+
+		brackets += (*q == '[') - (*q == ']');
+	}
+
+	if(q < end && *q == '{') {
+		++q;
+		while(q < end && is_whitespace(*q))
+			++q;
+
+		char const* name = q;
+		while(q < end && (is_js_identifier_char(*q) || *q == '-'))
+			++q;
+		while(q < end && is_whitespace(*q))
+			++q;
+
+		if(q < end && (*q == '}' || (*q == ':' && q > name)))
+			return lang_t::css;
+	}
+
+	return lang_t::unspecified;
+}
+
+/*
+ *  minifies the blocks minify_html set aside, on up to no_threads threads
+ *  once there is enough of them, and splices them into minified where
+ *  they were taken out. with a budget, the threads past the caller's own
+ *  are claimed from it only then, and handed back after
+ */
+inline void splice_inline_blocks(
+	std::vector<inline_block> const& blocks,
+	minify::type::string const& sources,
+	minify::type::string& minified,
+	ptrdiff_t& pos_minified,
+	bool const& minify_comments,
+	comment_mode_t const& comment_mode,
+	std::size_t const& no_threads,
+	minify::thread_budget* budget
+) {
+	std::vector<minify::type::string> bodies(blocks.size());
+	std::size_t lent = 0,
+	            threads = 1;
+
+	if(sources.length() >= inline_parallel_threshold && no_threads > 1) {
+		if(budget)
+			threads += (lent = budget->claim(no_threads - 1));
+		else
+			threads = no_threads;
+	}
+
+	minify::parallel_for(
+		threads,
+		blocks.size(),
+		[&](std::size_t const& b) {
+			bodies[b].append(sources.c_str() + blocks[b].pos_source, blocks[b].length);
+
+			if(blocks[b].lang == lang_t::js)
+				minify_js(bodies[b], minify_comments, comment_mode);
+			else if(blocks[b].lang == lang_t::css)
+				minify_css(bodies[b], minify_comments, comment_mode);
+			else if(blocks[b].lang == lang_t::json)
+				minify_json(bodies[b], minify_comments, comment_mode, 0);
+		}
+	);
+
+	if(budget)
+		budget->release(lent);
+
+	std::ptrdiff_t grown = 0;
+	for(std::size_t b=0; b<bodies.size(); ++b)
+		grown += bodies[b].length();
+
+	if(minified.capacity() <= pos_minified + grown + 2)
+		minified.strict_resize(pos_minified + grown + 2);
+
+	//from the back, so each stretch of the page moves only once
+	std::ptrdiff_t end = pos_minified + 1;
+	for(std::size_t b=bodies.size(); b--;) {
+		std::ptrdiff_t const at = blocks[b].pos_minified;
+
+		memmove(&minified[at + grown], &minified[at], end - at);
+		grown -= bodies[b].length();
+		memcpy(&minified[at + grown], bodies[b].c_str(), bodies[b].length());
+		end = at;
+	}
+
+	for(std::size_t b=0; b<bodies.size(); ++b)
+		pos_minified += bodies[b].length();
 }
 
-void minify_html(
+inline void minify_html(
 	minify::type::string const& html,
 	ptrdiff_t& pos_html,
 	minify::type::string& minified,
 	ptrdiff_t& pos_minified,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
-	bool const& minify_capacity = 0
+	bool const& minify_capacity = 0,
+	std::size_t const& no_threads = 1,
+	minify::thread_budget* budget = nullptr
 ) {
 	bool between_close_and_open = 0,
 	     inside_tag = 0,
 	     inside_pre = 0;
 	char quote_type;
+	lang_t inline_lang = lang_t::unspecified;
 	std::size_t comment_depth = 0;
-	std::ptrdiff_t pos_begin;
-	minify::type::string cstr;
+	std::ptrdiff_t pos_begin,
+	               pos_tag = 0;
+	//script and style bodies are set aside and minified once the page is done
+	minify::type::string inline_sources;
+	std::vector<inline_block> inline_blocks;
 
 	if(minified.capacity() <= html.length())
 		minified.strict_resize(html.length()+1);
@@ -1296,7 +1583,30 @@ void minify_html(
 			inside_tag = 0;
 			minified[++pos_minified] = angle_close;
 
-			if(inside_pre) {
+			if(inline_lang != lang_t::unspecified) {
+				pos_begin = ++pos_html;
+				pos_html = find_closing_tag(
+					html,
+					pos_begin,
+					(inline_lang == lang_t::js)
+						? minify::type::string_view("</script")
+						: minify::type::string_view("</style")
+				);
+
+				if(pos_html > pos_begin) {
+					inline_blocks.push_back(inline_block{
+						(inline_lang == lang_t::js)
+							? inline_script_lang(minified, pos_tag, pos_minified)
+							: inline_lang,
+						pos_minified + 1,
+						inline_sources.length(),
+						pos_html - pos_begin
+					});
+					inline_sources.append(&html[pos_begin], pos_html - pos_begin);
+				}
+				inline_lang = lang_t::unspecified;
+			}
+			else if(inside_pre) {
 				cpy_pre_block(
 					html, 
 					pos_begin = ++pos_html,
@@ -1366,29 +1676,23 @@ void minify_html(
 					pos_html < html.size() &&
 					html[pos_html] == 's'
 				) {
-					if(cstr.substr(html, pos_html+2, 5) == "cript") 
-						minify_js(
-							html,
-							pos_html,
-							minified,
-							pos_minified,
-							minify_comments,
-							comment_mode,
-							minify_capacity);
-					else if(cstr.substr(html, pos_html+2, 4) == "tyle")
-						minify_css(
-							html,
-							pos_html,
-							minified,
-							pos_minified,
-							minify_comments,
-							comment_mode,
-							minify_capacity);
+					pos_tag = pos_minified;
+
+					if(
+						html.view(pos_html+1, 5) == "cript" &&
+						is_tag_name_end(html, pos_html+6)
+					)
+						inline_lang = lang_t::js;
+					else if(
+						html.view(pos_html+1, 4) == "tyle" &&
+						is_tag_name_end(html, pos_html+5)
+					)
+						inline_lang = lang_t::css;
 				}
 				else if(
 					pos_html < html.size() &&
 					html[pos_html] == 'p'  &&
-					cstr.substr(html, pos_html+1, 2) == "re"
+					html.view(pos_html+1, 2) == "re"
 				) {
 					inside_pre = 1;
 					cpy_between(
@@ -1403,7 +1707,7 @@ void minify_html(
 				else if(
 					pos_html < html.size() &&
 					html[pos_html] == 'c'  &&
-					cstr.substr(html, pos_html+1, 3) == "ode"
+					html.view(pos_html+1, 3) == "ode"
 				) {
 					inside_pre = 1;
 					cpy_between(
@@ -1418,7 +1722,7 @@ void minify_html(
 				else if(
 					pos_html < html.size() &&
 					html[pos_html] == 't'  &&
-					cstr.substr(html, pos_html+1, 7) == "extarea"
+					html.view(pos_html+1, 7) == "extarea"
 				) {
 					inside_pre = 1;
 					cpy_between(
@@ -1442,7 +1746,7 @@ void minify_html(
 			html[pos_html+4] == 'e'   && 
 			html[pos_html+5] == 'n'   && 
 			html[pos_html+6] == 't'   && 
-			cstr.substr(html, pos_html+7, 8) == "editable"
+			html.view(pos_html+7, 8) == "editable"
 		) {
 			inside_pre = 1;
 			cpy_between(
@@ -1474,6 +1778,18 @@ void minify_html(
 		}
 	}
 
+	if(inline_blocks.size())
+		splice_inline_blocks(
+			inline_blocks,
+			inline_sources,
+			minified,
+			pos_minified,
+			minify_comments,
+			comment_mode,
+			no_threads,
+			budget
+		);
+
 	minified[++pos_minified] = '\0';
 	minified.length(pos_minified);
 
@@ -1481,12 +1797,14 @@ void minify_html(
 		minified.strict_resize(pos_minified);
 }
 
-void minify_html(
+inline void minify_html(
 	minify::type::string const& html,
 	minify::type::string& minified,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
-	bool const& minify_capacity = 0
+	bool const& minify_capacity = 0,
+	std::size_t const& no_threads = 1,
+	minify::thread_budget* budget = nullptr
 ) {
 	ptrdiff_t pos_html = 0, pos_minified = -1;
 	minify_html(
@@ -1496,15 +1814,19 @@ void minify_html(
 		pos_minified,
 		minify_comments,
 		comment_mode,
-		minify_capacity
+		minify_capacity,
+		no_threads,
+		budget
 	);
 }
 
-void minify_html(
+inline void minify_html(
 	minify::type::string& html,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
-	bool const& minify_capacity = 0
+	bool const& minify_capacity = 0,
+	std::size_t const& no_threads = 1,
+	minify::thread_budget* budget = nullptr
 ) {
 	ptrdiff_t pos_html = 0, pos_minified = -1;
 	minify_html(
@@ -1514,11 +1836,13 @@ void minify_html(
 		pos_minified,
 		minify_comments,
 		comment_mode,
-		minify_capacity
+		minify_capacity,
+		no_threads,
+		budget
 	);
 }
 
-void minify_json(
+inline void minify_json(
 	minify::type::string const& json,
 	minify::type::string& minified,
 	bool const& minify_comments = 1,
@@ -1530,10 +1854,26 @@ void minify_json(
 	std::ptrdiff_t pos_begin,
 		pos_json = 0,
 		pos_minified = -1;
-	minify::type::string cstr;
 
-	if(minified.capacity() < json.length())
-		minified.strict_resize(json.length()+1);
+	if(minified.capacity() <= json.length() + minify::simd::json_padding)
+		minified.strict_resize(json.length() + minify::simd::json_padding + 1);
+
+	//plain json (no comments or ' and ` quotes) takes the vectorised path
+	pos_minified = minify::simd::minify_json(
+		json.c_str(), 
+		json.length(), 
+		&minified[0]
+	);
+
+	if(pos_minified >= 0) {
+		minified[pos_minified] = '\0';
+		minified.length(pos_minified);
+
+		if(minify_capacity)
+			minified.strict_resize(pos_minified);
+
+		return;
+	}
 
 	while(pos_json < json.length()) {
 		if(is_quote_mark(json[pos_json]))
@@ -1641,7 +1981,7 @@ void minify_json(
 		minified.strict_resize(pos_minified);
 }
 
-void minify_json(
+inline void minify_json(
 	minify::type::string& json,
 	bool const& minify_comments = 1,
 	comment_mode_t const& comment_mode = comment_mode_t::strip,
@@ -1656,212 +1996,246 @@ void minify_json(
 	);
 }
 
-#include <sys/stat.h>
-bool path_exists(minify::type::string const& path) {
-	struct stat info;
+namespace minify {
+	/*
+	 *  minifies css or json handed over a piece at a time, memory stays
+	 *  bounded by the pieces plus the longest stretch of the document
+	 *  without a cut (see stream.h), output matches minifying it whole
+	 *
+	 * 	example:
+	 * 		minify::stream json(lang_t::json);
+	 * 		minify::type::string_view out;
+	 * 		while((out = json.read(f)).length() || !feof(f))
+	 * 			fwrite(out.data(), 1, out.length(), stdout);
+	 * 		out = json.finish();
+	 * 		fwrite(out.data(), 1, out.length(), stdout);
+	 */
+	class stream {
+		lang_t lang_;
+		bool minify_comments_;
+		comment_mode_t comment_mode_;
+		boundary_scanner scanner_;
+		minify::type::string pending_,
+		                     minified_;
+		std::ptrdiff_t scanned_ = 0;
+		bool finished_ = 0;
+
+		//minifies and drops the first length bytes of pending_
+		minify::type::string_view minify_front(
+			std::ptrdiff_t const& length
+		) {
+			std::ptrdiff_t const total = pending_.length();
+			char const kept = pending_[length];
 
-	if(stat(path.c_str(), &info ) != 0) 
-		return 0; //does not exist
-	else
-		return 1; //exists
-}
-bool dir_exists(minify::type::string const& path) {
-	struct stat info;
-
-	if(stat( path.c_str(), &info ) != 0) 
-		return 0; //path doesn't exist
-	else if(info.st_mode & S_IFDIR) 
-		return 1; //dir
-	else 
-		return 0; //file
-}
-bool file_exists(minify::type::string const& path) {
-	struct stat info;
-
-	if(stat( path.c_str(), &info ) != 0) 
-		return 0; //path nonexistent
-	else if(info.st_mode & S_IFDIR) 
-		return 0; //dir
-	else 
-		return 1; //file
-}
+			pending_.length(length);
 
-int make_dir(minify::type::string const& dir) {
-	#if defined _WIN32 || defined _WIN64
-		return _mkdir(
-			dir.c_str()
-		); //windows 
-	#else 
-		return mkdir(
-			dir.c_str(), 
-			S_IRWXU | 
-			S_IRWXG | 
-			S_IROTH | 
-			S_IXOTH
-		); //*[bsd|nix]
-	#endif
-}
+			if(lang_ == lang_t::css)
+				minify_css(
+					pending_,
+					minified_,
+					minify_comments_,
+					comment_mode_
+				);
+			else
+				minify_json(
+					pending_,
+					minified_,
+					minify_comments_,
+					comment_mode_
+				);
 
-int create_dirs(minify::type::string const& path) {
-	minify::type::string dir;
+			pending_[length] = kept;
+			pending_.length(total);
+			pending_.erase_front(length);
+			scanned_ -= length;
 
-	for(std::ptrdiff_t i=0; i<path.length(); ++i) {
-		if(path[i] == '/' || path[i] == '\\') {
-			dir.substr(path, 0, i);
-			if(!dir_exists(dir) && make_dir(dir))
-				return 0;
+			return minified_.view(0, minified_.length());
 		}
-	}
 
-	return 1;
-}
+		minify::type::string_view advance(
+			bool const& at_eof
+		) {
+			std::ptrdiff_t cut = 0;
+
+			scanned_ = scanner_.scan(
+				pending_.c_str(),
+				scanned_,
+				pending_.length(),
+				at_eof,
+				cut
+			);
 
-/*#include <unistd.h>
-#include <fcntl.h>
-#ifdef _WIN32
-	#include <direct.h>
-#endif
-
-bool create_file(minify::type::string const& path) {
-	if(path.length())
-	{
-		close(creat(path.c_str(), O_CREAT));
-		chmod(path.c_str(), 0644);
-	}
+			if(at_eof || scanner_.terminated()) {
+				finished_ = 1;
 
-	return 0;
-}*/
+				if(!pending_.length())
+					return minify::type::string_view();
 
-void get_filename(
-	minify::type::string& path,
-	minify::type::string& file
-) {
-	for(std::size_t i=path.length()-1; i!=std::string::npos; --i) {
-		if(path[i] == '/' || path[i] == '\\') {
-			file.substr(
-				path,
-				i+1, 
-				path.length()-i-1);
-			break;
+				return minify_front(pending_.length());
+			}
+			else if(cut)
+				return minify_front(cut);
+
+			return minify::type::string_view();
 		}
-	}
 
-}
+		public:
+		static constexpr std::ptrdiff_t BLOCK_SIZE = 1 << 20;
+
+		//lang must be lang_t::css or lang_t::json
+		explicit stream(
+			lang_t const& lang,
+			bool const& minify_comments = 1,
+			comment_mode_t const& comment_mode = comment_mode_t::strip
+		) :
+			lang_(lang),
+			minify_comments_(minify_comments),
+			comment_mode_(comment_mode),
+			scanner_(
+				lang == lang_t::css,
+				comment_mode != comment_mode_t::keep,
+				comment_mode == comment_mode_t::strip_all,
+				minify_comments
+			) {
+		}
 
-void append_filename(
-	minify::type::string& path,
-	minify::type::string& dir
-) {
-	for(std::size_t i=path.length()-1; i!=std::string::npos; --i) {
-		if(path[i] == '/' || path[i] == '\\') {
-			dir.append_substr(
-				path,
-				i+1, 
-				path.length()-i-1);
-			break;
+		stream(stream const&) = delete;
+		stream& operator=(stream const&) = delete;
+
+		/*
+		 *  takes the next length bytes of the document, returns whatever
+		 *  could be minified so far (valid until the next call)
+		 */
+		minify::type::string_view push(
+			char const* data,
+			std::ptrdiff_t const& length
+		) {
+			if(finished_)
+				return minify::type::string_view();
+
+			pending_.append(data, length);
+
+			return advance(0);
 		}
-	}
 
-}
+		//as push, reading the next block straight from f
+		minify::type::string_view read(
+			FILE* f,
+			std::ptrdiff_t const& length = std::ptrdiff_t(BLOCK_SIZE)
+		) {
+			if(finished_)
+				return minify::type::string_view();
 
-enum class output_t {
-	file,
-	directory,
-	terminal
-};
+			pending_.append(f, length);
 
-#include <atomic>
-#include <mutex>
-#include <thread>
-
-static bool minify_comments = 1;
-static comment_mode_t comment_mode = comment_mode_t::strip_all;
-static lang_t lang = lang_t::unspecified;
-static output_t output_type = output_t::terminal;
-static std::atomic<std::size_t> counter(-1);
-static std::mutex mtx;
-static std::vector<char const*> to_minify;
-static std::vector<char*> minified_vec;
-static minify::type::string exec_name, specified_output_path;
-
-void minify_thrd() {
-	std::size_t i=0;
-	minify::type::string code,
-	                     input_path,
-	                     output_path;
-	std::ptrdiff_t const op_length = specified_output_path.length();
-	FILE* f;
-
-	if(output_type == output_t::directory)
-		output_path.assign(specified_output_path.c_str());
-
-	while((i = ++counter) < to_minify.size()) {
-		input_path.assign(to_minify[i]);
-
-		if(file_exists(input_path)) {
-			code.load_file(to_minify[i]);
-
-			switch(lang) {
-				case lang_t::css:
-					minify_css(
-						code, 
-						minify_comments, 
-						comment_mode
-					);
-					break;
-				case lang_t::html:
-					minify_html(
-						code, 
-						minify_comments, 
-						comment_mode
-					);
-					break;
-				case lang_t::js:
-					minify_js(
-						code, 
-						minify_comments, 
-						comment_mode
-					);
-					break;
-				case lang_t::json:
-					minify_json(
-						code, 
-						minify_comments, 
-						comment_mode
-					);
-					break;
-				default:
-					std::cout << "no language specified" << std::endl;
-					break;
-			}
+			return advance(0);
+		}
 
-			if(
-				output_type == output_t::terminal ||
-				output_type == output_t::file
-			) {
-				mtx.lock();
-				minified_vec[i] = (char*) malloc(sizeof(char)*(code.length()+1));
-				memcpy(&minified_vec[i][0], &code[0], code.length());
-				minified_vec[i][code.length()] = '\0';
-				mtx.unlock();
-			}
-			else if(output_type == output_t::directory) {
-				append_filename(input_path, output_path);
+		//the document is complete, returns the rest of the output
+		minify::type::string_view finish() {
+			if(finished_)
+				return minify::type::string_view();
 
-				f = fopen(output_path.c_str(), "w");
-				fputs(code.c_str(), f);
-				fclose(f);
-				f = nullptr;
+			return advance(1);
+		}
 
-				output_path.length(op_length);
-			}
+		bool const& finished() const {
+			return finished_;
 		}
+	};
+}
+
+//css and json inputs at least this large are split up and minified on every core
+static std::ptrdiff_t const split_threshold = 1 << 23;
+
+/*
+ *  json minifies several times faster than it can be scanned for cuts, so
+ *  splitting only comes out ahead once the scan is shared by enough threads
+ */
+inline bool worth_splitting(
+	lang_t const& lang,
+	std::ptrdiff_t const& length,
+	std::size_t const& no_threads
+) {
+	return length >= split_threshold && (
+		(lang == lang_t::css && no_threads >= 2) ||
+		(lang == lang_t::json && no_threads >= 8)
+	);
+}
+
+/*
+ *  minifies one large css or json document on up to no_threads threads,
+ *  cutting it where minifying the pieces apart gives exactly what
+ *  minifying it whole does (see boundary_scanner) and splicing the
+ *  minified pieces back together in order. src and dst can be the same
+ */
+inline void minify_split(
+	lang_t const& lang,
+	minify::type::string const& src,
+	minify::type::string& dst,
+	bool const& minify_comments,
+	comment_mode_t const& comment_mode,
+	std::size_t const& no_threads
+) {
+	//a few pieces per thread evens out pieces that minify slower
+	std::size_t const no_pieces = std::min(
+		no_threads * 4,
+		std::size_t(src.length() >> 20) + 1
+	);
+
+	std::vector<std::ptrdiff_t> const cuts = minify::find_cuts(
+		minify::boundary_scanner(
+			lang == lang_t::css,
+			comment_mode != comment_mode_t::keep,
+			comment_mode == comment_mode_t::strip_all,
+			minify_comments
+		),
+		src.c_str(),
+		src.length(),
+		no_pieces,
+		no_threads
+	);
+	std::vector<std::ptrdiff_t> lengths(cuts.size() - 1);
+
+	/*
+	 *  a piece never minifies to more than it was, so each is written back
+	 *  where it came from in dst and only the pieces being minified are
+	 *  held twice
+	 */
+	if(&dst != &src) {
+		dst.length(src.length());
+		memcpy(&dst[0], src.c_str(), src.length());
+	}
+
+	minify::parallel_for(no_threads, lengths.size(), [&](std::size_t const& i) {
+		minify::type::string piece;
+
+		piece.append(dst.c_str() + cuts[i], cuts[i+1] - cuts[i]);
+
+		if(lang == lang_t::css)
+			minify_css(
+				piece,
+				minify_comments,
+				comment_mode
+			);
 		else
-		{
-			std::cout << "error: " << exec_name << ": ";
-			std::cout << "source file '" << input_path << "' does not exist" << std::endl;
-		}
+			minify_json(
+				piece,
+				minify_comments,
+				comment_mode
+			);
+
+		lengths[i] = piece.length();
+		memcpy(&dst[cuts[i]], piece.c_str(), lengths[i]);
+	});
+
+	//closes the gaps the pieces left behind
+	std::ptrdiff_t end = 0;
+	for(std::size_t i=0; i<lengths.size(); ++i) {
+		memmove(&dst[end], &dst[cuts[i]], lengths[i]);
+		end += lengths[i];
 	}
+	dst.length(end);
 }
 
 #endif //MANTIS_MINIFY_H
\ No newline at end of file
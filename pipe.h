@@ -0,0 +1,76 @@
+/**
+ *  hand off between the threads of the stdin pipeline
+ *
+ *  two blocks go back and forth between a producer and a consumer, so
+ *  one block is being filled while the other is being drained. the
+ *  producer blocks once both are full, which bounds memory and lets a
+ *  slow end of the pipe hold the other back
+ */
+
+#ifndef MINIFY_PIPE_H
+#define MINIFY_PIPE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+#include "string.h"
+
+namespace minify {
+	class double_buffer {
+		minify::type::string blocks_[2];
+		std::size_t filled_  = 0,
+		            drained_ = 0;
+		bool closed_ = 0;
+		std::mutex mtx_;
+		std::condition_variable cv_;
+
+		public:
+		double_buffer() {}
+		double_buffer(double_buffer const&) = delete;
+		double_buffer& operator=(double_buffer const&) = delete;
+
+		//waits for a free block, emptied and ready to be filled
+		minify::type::string& to_fill() {
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this] { return filled_ - drained_ < 2; });
+
+			minify::type::string& block = blocks_[filled_ % 2];
+			block.length(0);
+			return block;
+		}
+
+		//passes the block from to_fill over to the consumer
+		void filled() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			++filled_;
+			cv_.notify_all();
+		}
+
+		//nothing more will be filled
+		void close() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			closed_ = 1;
+			cv_.notify_all();
+		}
+
+		//waits for the next filled block, nullptr once closed and drained
+		minify::type::string* to_drain() {
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this] { return filled_ != drained_ || closed_; });
+
+			if(filled_ == drained_)
+				return nullptr;
+			return &blocks_[drained_ % 2];
+		}
+
+		//hands the block from to_drain back to the producer
+		void drained() {
+			std::lock_guard<std::mutex> lock(mtx_);
+			++drained_;
+			cv_.notify_all();
+		}
+	};
+}
+
+#endif //MINIFY_PIPE_H
@@ -0,0 +1,228 @@
+/**
+ *  spreads the input files over the worker threads
+ *
+ *  every input gets a cost up front (its size, or its size times the rate
+ *  it minified at last time when there is a cost_history). inputs too
+ *  cheap to be worth a task of their own are batched together, then the
+ *  tasks are dealt out largest first, each to the worker with the least
+ *  work so far (longest processing time first), which keeps one large
+ *  input from being left for last. each worker works through its own
+ *  queue largest first and once it runs dry takes the smallest task off
+ *  the back of another worker's queue, so estimates that were off even
+ *  themselves out
+ */
+
+#ifndef MINIFY_SCHEDULER_H
+#define MINIFY_SCHEDULER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace minify {
+	class scheduler {
+		public:
+		//inputs order[first, last) make up the task
+		struct task {
+			std::size_t first,
+			            last;
+		};
+
+		private:
+		struct worker_queue {
+			std::mutex mtx;
+			std::deque<task> tasks;
+		};
+
+		std::vector<std::size_t> order_;
+		std::vector<std::unique_ptr<worker_queue> > queues_;
+
+		public:
+		/*
+		 *  costs       - the estimated cost of each input
+		 *  no_workers  - the most workers to deal out to, there are never
+		 *                more than there are tasks (see workers)
+		 *  batch_cost  - inputs costing less are batched up to about this
+		 */
+		scheduler(
+			std::vector<double> const& costs,
+			std::size_t const& no_workers,
+			double const& batch_cost
+		) :
+			order_(costs.size()) {
+			std::iota(order_.begin(), order_.end(), std::size_t(0));
+			std::stable_sort(
+				order_.begin(),
+				order_.end(),
+				[&costs](std::size_t const& a, std::size_t const& b) {
+					return costs[a] > costs[b];
+				}
+			);
+
+			//tasks largest first, the cheap inputs at the end share tasks
+			std::vector<task> tasks;
+			std::vector<double> task_costs;
+			for(std::size_t i=0; i<order_.size();) {
+				std::size_t last = i + 1;
+				double cost = costs[order_[i]];
+
+				if(cost < batch_cost)
+					while(last < order_.size() && cost + costs[order_[last]] <= batch_cost)
+						cost += costs[order_[last++]];
+
+				tasks.push_back(task{i, last});
+				task_costs.push_back(cost);
+				i = last;
+			}
+
+			//batches of small inputs can cost more than the single inputs before them
+			std::vector<std::size_t> by_cost(tasks.size());
+			std::iota(by_cost.begin(), by_cost.end(), std::size_t(0));
+			std::stable_sort(
+				by_cost.begin(),
+				by_cost.end(),
+				[&task_costs](std::size_t const& a, std::size_t const& b) {
+					return task_costs[a] > task_costs[b];
+				}
+			);
+
+			for(std::size_t w=0; w<std::max<std::size_t>(std::min(no_workers, tasks.size()), 1); ++w)
+				queues_.push_back(std::unique_ptr<worker_queue>(new worker_queue()));
+
+			//each task to the worker with the least so far
+			typedef std::pair<double, std::size_t> load;
+			std::priority_queue<load, std::vector<load>, std::greater<load> > loads;
+			for(std::size_t w=0; w<queues_.size(); ++w)
+				loads.push(load(0, w));
+
+			for(std::size_t t=0; t<by_cost.size(); ++t) {
+				load least = loads.top();
+				loads.pop();
+
+				queues_[least.second]->tasks.push_back(tasks[by_cost[t]]);
+				least.first += task_costs[by_cost[t]];
+				loads.push(least);
+			}
+		}
+
+		scheduler(scheduler const&) = delete;
+		scheduler& operator=(scheduler const&) = delete;
+
+		//how many workers should call next, from 0 up
+		std::size_t workers() const {
+			return queues_.size();
+		}
+
+		//the input at position i of the order tasks index into
+		std::size_t const& input(std::size_t const& i) const {
+			return order_[i];
+		}
+
+		//the next task for worker, 0 once there are none left anywhere
+		bool next(
+			std::size_t const& worker,
+			task& t
+		) {
+			for(std::size_t w=0; w<queues_.size(); ++w) {
+				worker_queue& queue = *queues_[(worker + w) % queues_.size()];
+				std::lock_guard<std::mutex> lock(queue.mtx);
+
+				if(queue.tasks.size()) {
+					if(!w) {
+						t = queue.tasks.front();
+						queue.tasks.pop_front();
+					}
+					else {
+						t = queue.tasks.back();
+						queue.tasks.pop_back();
+					}
+
+					return 1;
+				}
+			}
+
+			return 0;
+		}
+	};
+
+	/*
+	 *  how long each input took to minify last time, kept as nanoseconds
+	 *  per byte so an input that has since grown or shrunk still gets a
+	 *  fair estimate. the file holds a line per input: rate path
+	 */
+	class cost_history {
+		std::map<std::string, double> rates_;
+		double mean_rate_ = 1;
+
+		public:
+		void load(char const* path) {
+			FILE* f = fopen(path, "r");
+			if(!f)
+				return;
+
+			double rate;
+			char line[4096];
+			while(fscanf(f, "%lf %4095[^\n]", &rate, line) == 2)
+				rates_[line] = rate;
+
+			fclose(f);
+
+			if(rates_.size()) {
+				double total = 0;
+				for(std::map<std::string, double>::const_iterator r = rates_.begin(); r != rates_.end(); ++r)
+					total += r->second;
+				mean_rate_ = total / rates_.size();
+			}
+		}
+
+		//written next to path and renamed over it, so a reader never sees half a file
+		void save(char const* path) const {
+			std::string const temp = std::string(path) + ".tmp";
+			FILE* f = fopen(temp.c_str(), "w");
+			if(!f)
+				return;
+
+			for(std::map<std::string, double>::const_iterator r = rates_.begin(); r != rates_.end(); ++r)
+				fprintf(f, "%.6g %s\n", r->second, r->first.c_str());
+
+			if(fclose(f) == 0)
+				rename(temp.c_str(), path);
+			else
+				remove(temp.c_str());
+		}
+
+		//the cost to expect for size bytes of path, in nanoseconds
+		double estimate(
+			char const* path,
+			double const& size
+		) const {
+			std::map<std::string, double>::const_iterator r = rates_.find(path);
+
+			return size * ((r != rates_.end()) ? r->second : mean_rate());
+		}
+
+		void record(
+			char const* path,
+			double const& size,
+			double const& nanoseconds
+		) {
+			if(size > 0)
+				rates_[path] = nanoseconds / size;
+		}
+
+		//the rate assumed for inputs not seen before (as of load)
+		double const& mean_rate() const {
+			return mean_rate_;
+		}
+	};
+}
+
+#endif //MINIFY_SCHEDULER_H
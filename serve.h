@@ -0,0 +1,514 @@
+/**
+ *  the pieces of --serve, a minimal http/1.1 server for a directory
+ *
+ *  css, js, json and html are minified the first time they are asked for
+ *  and kept in memory, least recently used first out, under their path,
+ *  modification time and size, so a file that changes is minified again.
+ *  a minified file is kept as an in-memory file and everything is sent
+ *  kernel side with sendfile. etags are the hash of what is sent, so a
+ *  client with If-None-Match is answered 304 without a body
+ */
+
+#ifndef MINIFY_SERVE_H
+#define MINIFY_SERVE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "daemon.h"
+#include "hash.h"
+#include "mantis-minify.h"
+
+#ifdef MINIFY_HAS_DAEMON
+	#include <fcntl.h>
+	#include <netinet/in.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+	#ifdef __linux__
+		#include <sys/sendfile.h>
+		#include <sys/syscall.h>
+	#endif
+
+namespace minify {
+	namespace http {
+		//requests with more header than this are refused
+		static constexpr std::size_t max_header = 1 << 14;
+
+		//a file as it is sent, the minified output or the file itself
+		struct asset {
+			int fd = -1;
+			off_t size = 0;
+			std::string etag;
+			char const* type = "application/octet-stream";
+
+			asset() = default;
+			asset(asset const&) = delete;
+			asset& operator=(asset const&) = delete;
+
+			~asset() {
+				if(fd >= 0)
+					::close(fd);
+			}
+		};
+
+		/*
+		 *  the minified assets, least recently used first out once they add
+		 *  up to more than capacity bytes. an asset is held by whoever is
+		 *  sending it, so one that is evicted mid send is closed after
+		 */
+		class asset_cache {
+			struct slot {
+				std::string path;
+				std::int64_t mtime;
+				off_t size;
+				std::shared_ptr<asset const> data;
+			};
+
+			std::size_t capacity_,
+			            used_ = 0;
+			//most recently used first
+			std::list<slot> order_;
+			std::unordered_map<std::string, std::list<slot>::iterator> slots_;
+			std::mutex mtx_;
+
+			void erase(std::list<slot>::iterator const s) {
+				used_ -= s->data->size;
+				slots_.erase(s->path);
+				order_.erase(s);
+			}
+
+			public:
+			explicit asset_cache(std::size_t const& capacity) :
+				capacity_(capacity) {}
+
+			//the asset for path as it was at mtime with size bytes, null on a miss
+			std::shared_ptr<asset const> find(
+				std::string const& path,
+				std::int64_t const& mtime,
+				off_t const& size
+			) {
+				std::lock_guard<std::mutex> lock(mtx_);
+				std::unordered_map<std::string, std::list<slot>::iterator>::iterator s = slots_.find(path);
+
+				if(s == slots_.end())
+					return nullptr;
+				if(s->second->mtime != mtime || s->second->size != size) {
+					erase(s->second);
+					return nullptr;
+				}
+
+				order_.splice(order_.begin(), order_, s->second);
+				return s->second->data;
+			}
+
+			//keeps data for path, unless it is larger than the whole cache
+			void insert(
+				std::string const& path,
+				std::int64_t const& mtime,
+				off_t const& size,
+				std::shared_ptr<asset const> const& data
+			) {
+				if(std::size_t(data->size) > capacity_)
+					return;
+
+				std::lock_guard<std::mutex> lock(mtx_);
+				std::unordered_map<std::string, std::list<slot>::iterator>::iterator s = slots_.find(path);
+				if(s != slots_.end())
+					erase(s->second);
+
+				while(order_.size() && used_ + data->size > capacity_)
+					erase(std::prev(order_.end()));
+
+				slot added = { path, mtime, size, data };
+				order_.push_front(std::move(added));
+				slots_[path] = order_.begin();
+				used_ += data->size;
+			}
+		};
+
+		//the extension of path, lower case and without the dot
+		inline std::string extension(std::string const& path) {
+			std::size_t const dot = path.rfind('.');
+			if(dot == std::string::npos || path.find('/', dot) != std::string::npos)
+				return "";
+
+			std::string ext = path.substr(dot + 1);
+			for(std::size_t c=0; c<ext.size(); ++c)
+				if(ext[c] >= 'A' && ext[c] <= 'Z')
+					ext[c] += 'a' - 'A';
+
+			return ext;
+		}
+
+		inline char const* content_type(std::string const& ext) {
+			static std::pair<char const*, char const*> const types[] = {
+				{ "css",   "text/css; charset=utf-8" },
+				{ "js",    "text/javascript; charset=utf-8" },
+				{ "mjs",   "text/javascript; charset=utf-8" },
+				{ "cjs",   "text/javascript; charset=utf-8" },
+				{ "json",  "application/json" },
+				{ "html",  "text/html; charset=utf-8" },
+				{ "htm",   "text/html; charset=utf-8" },
+				{ "txt",   "text/plain; charset=utf-8" },
+				{ "xml",   "application/xml" },
+				{ "svg",   "image/svg+xml" },
+				{ "png",   "image/png" },
+				{ "jpg",   "image/jpeg" },
+				{ "jpeg",  "image/jpeg" },
+				{ "gif",   "image/gif" },
+				{ "webp",  "image/webp" },
+				{ "ico",   "image/x-icon" },
+				{ "woff",  "font/woff" },
+				{ "woff2", "font/woff2" },
+				{ "wasm",  "application/wasm" },
+				{ "pdf",   "application/pdf" }
+			};
+
+			for(std::size_t t=0; t<sizeof(types)/sizeof(types[0]); ++t)
+				if(ext == types[t].first)
+					return types[t].second;
+
+			return "application/octet-stream";
+		}
+
+		//the modification time of info in nanoseconds
+		inline std::int64_t modified(struct stat const& info) {
+			#if defined __APPLE__
+				return std::int64_t(info.st_mtimespec.tv_sec) * 1000000000 + info.st_mtimespec.tv_nsec;
+			#else
+				return std::int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+			#endif
+		}
+
+		inline std::string make_etag(std::uint64_t const& value) {
+			char etag[24];
+			snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long) value);
+			return etag;
+		}
+
+		//an unlinked file holding length bytes at data, to be sent with sendfile. -1 on a failure
+		inline int memory_file(
+			char const* data,
+			std::size_t length
+		) {
+			#if defined __linux__ && defined __NR_memfd_create
+				int fd = syscall(__NR_memfd_create, "mantis-minify", 1u /* MFD_CLOEXEC */);
+			#else
+				int fd = -1;
+			#endif
+
+			if(fd < 0) {
+				char path[] = "/tmp/mantis-minify.XXXXXX";
+				if((fd = mkstemp(path)) < 0)
+					return -1;
+				unlink(path);
+			}
+
+			for(off_t at=0; length;) {
+				ssize_t const put = pwrite(fd, data, length, at);
+
+				if(put < 0 && errno == EINTR)
+					continue;
+				if(put <= 0) {
+					::close(fd);
+					return -1;
+				}
+
+				data   += put;
+				at     += put;
+				length -= put;
+			}
+
+			return fd;
+		}
+
+		//sends size bytes of fd from the start, 0 if the connection failed
+		inline bool send_file(
+			int const& sock,
+			int const& fd,
+			off_t const& size
+		) {
+			off_t at = 0;
+
+			#ifdef __linux__
+				while(at < size) {
+					ssize_t const sent = sendfile(sock, fd, &at, size - at);
+
+					if(sent < 0 && errno == EINTR)
+						continue;
+					if(sent < 0 && (errno == EINVAL || errno == ENOSYS) && !at)
+						break; //not supported for this file, sent below
+					if(sent <= 0)
+						return 0;
+				}
+			#endif
+
+			char buffer[1 << 16];
+			while(at < size) {
+				ssize_t const got = pread(fd, buffer, std::min<off_t>(sizeof(buffer), size - at), at);
+
+				if(got < 0 && errno == EINTR)
+					continue;
+				if(got <= 0 || !minify::daemon::send_all(sock, buffer, got))
+					return 0;
+
+				at += got;
+			}
+
+			return 1;
+		}
+
+		struct request {
+			std::string method,
+			            target,
+			            if_none_match;
+			bool keep_alive = 1;
+		};
+
+		//header named name (lower case) in the lines of head, empty if there is none
+		inline std::string header_value(
+			std::string const& head,
+			char const* name
+		) {
+			std::size_t const name_length = strlen(name);
+
+			for(std::size_t line=head.find("\r\n"); line != std::string::npos; line=head.find("\r\n", line)) {
+				line += 2;
+
+				std::size_t const colon = head.find(':', line);
+				if(colon == std::string::npos || colon - line != name_length)
+					continue;
+
+				std::size_t c = 0;
+				for(; c<name_length && (head[line+c] | 0x20) == name[c]; ++c);
+				if(c < name_length)
+					continue;
+
+				std::size_t const end = head.find("\r\n", colon);
+				std::size_t first = colon + 1,
+				            last  = end;
+				for(; first<last && (head[first] == ' ' || head[first] == '\t'); ++first);
+				for(; last>first && (head[last-1] == ' ' || head[last-1] == '\t'); --last);
+
+				return head.substr(first, last - first);
+			}
+
+			return "";
+		}
+
+		/*
+		 *  reads the next request on fd, keeping anything past it in buffer
+		 *  for the one after. 0 once the connection is closed, 200 for a
+		 *  request, or the status to refuse it with and close
+		 */
+		inline int read_request(
+			int const& fd,
+			std::string& buffer,
+			request& req
+		) {
+			std::size_t end;
+			char chunk[1 << 12];
+
+			while((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+				if(buffer.size() > max_header)
+					return 431;
+
+				ssize_t const got = ::recv(fd, chunk, sizeof(chunk), 0);
+				if(got < 0 && errno == EINTR)
+					continue;
+				if(got <= 0)
+					return 0;
+
+				buffer.append(chunk, got);
+			}
+
+			if(end > max_header)
+				return 431;
+
+			std::string const head = buffer.substr(0, end + 2);
+			buffer.erase(0, end + 4);
+
+			std::size_t const line_end = head.find("\r\n"),
+			                  first    = head.find(' '),
+			                  second   = (first < line_end) ? head.find(' ', first + 1) : std::string::npos;
+			if(second == std::string::npos || second > line_end)
+				return 400;
+
+			req.method = head.substr(0, first);
+			req.target = head.substr(first + 1, second - first - 1);
+			std::string const version = head.substr(second + 1, line_end - second - 1),
+			                  connection = header_value(head, "connection");
+
+			if(version != "HTTP/1.1" && version != "HTTP/1.0")
+				return 505;
+
+			//a body is not expected with GET or HEAD, rather than skip one the connection is closed after
+			if(header_value(head, "content-length").size() || header_value(head, "transfer-encoding").size())
+				req.keep_alive = 0;
+			else if(version == "HTTP/1.0")
+				req.keep_alive = (connection == "keep-alive" || connection == "Keep-Alive");
+			else
+				req.keep_alive = (connection != "close" && connection != "Close");
+
+			req.if_none_match = header_value(head, "if-none-match");
+			return 200;
+		}
+
+		//the value of a hex digit, -1 for anything else
+		inline int hex_digit(char const& c) {
+			if(c >= '0' && c <= '9')
+				return c - '0';
+			if((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+				return (c | 0x20) - 'a' + 10;
+			return -1;
+		}
+
+		/*
+		 *  the path under the served directory target asks for, percent
+		 *  escapes decoded and the query dropped. 0 for a target that is not
+		 *  an absolute path, or that would leave the directory
+		 */
+		inline bool local_path(
+			std::string const& target,
+			std::string& path
+		) {
+			path.clear();
+			if(target.empty() || target[0] != '/')
+				return 0;
+
+			for(std::size_t c=0; c<target.size() && target[c] != '?' && target[c] != '#'; ++c) {
+				char ch = target[c];
+
+				if(ch == '%') {
+					int const high = (c + 2 < target.size()) ? hex_digit(target[c+1]) : -1,
+					          low  = (c + 2 < target.size()) ? hex_digit(target[c+2]) : -1;
+					if(high < 0 || low < 0)
+						return 0;
+
+					ch = char(high << 4 | low);
+					c += 2;
+				}
+
+				if(!ch || ch == '\\')
+					return 0;
+				path += ch;
+			}
+
+			//no segment may be ..
+			for(std::size_t seg=0; seg<path.size();) {
+				std::size_t const next = std::min(path.find('/', seg + 1), path.size());
+				if(path.compare(seg, next - seg, "/..") == 0)
+					return 0;
+				seg = next;
+			}
+
+			return 1;
+		}
+
+		//whether the If-None-Match list match holds etag
+		inline bool etag_matches(
+			std::string const& match,
+			std::string const& etag
+		) {
+			if(match == "*")
+				return 1;
+
+			for(std::size_t at=0; at<match.size();) {
+				std::size_t const comma = std::min(match.find(',', at), match.size());
+				std::size_t first = at,
+				            last  = comma;
+				for(; first<last && match[first] == ' '; ++first);
+				for(; last>first && match[last-1] == ' '; --last);
+
+				//a weak etag matches its strong form
+				if(last - first > 2 && match.compare(first, 2, "W/") == 0)
+					first += 2;
+				if(match.compare(first, last - first, etag) == 0)
+					return 1;
+
+				at = comma + 1;
+			}
+
+			return 0;
+		}
+
+		//the status line and headers of a response, with an empty line to end them (no length if it is -1)
+		inline std::string response_head(
+			int const& status,
+			off_t const& length,
+			bool const& keep_alive,
+			std::string const& extra = ""
+		) {
+			char const* reason = "Error";
+			switch(status) {
+				case 200: reason = "OK"; break;
+				case 301: reason = "Moved Permanently"; break;
+				case 304: reason = "Not Modified"; break;
+				case 400: reason = "Bad Request"; break;
+				case 403: reason = "Forbidden"; break;
+				case 404: reason = "Not Found"; break;
+				case 405: reason = "Method Not Allowed"; break;
+				case 431: reason = "Request Header Fields Too Large"; break;
+				case 500: reason = "Internal Server Error"; break;
+				case 505: reason = "HTTP Version Not Supported"; break;
+			}
+
+			char line[128];
+			int const written = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", status, reason);
+			if(length >= 0)
+				snprintf(line + written, sizeof(line) - written, "Content-Length: %lld\r\n", (long long) length);
+
+			return line + extra + ((keep_alive) ? "" : "Connection: close\r\n") + "\r\n";
+		}
+
+		//a response with no more than a short body, for errors
+		inline bool send_status(
+			int const& fd,
+			int const& status,
+			bool const& keep_alive,
+			std::string const& extra = ""
+		) {
+			std::string const head = response_head(status, 0, keep_alive, extra);
+			return minify::daemon::send_all(fd, head.data(), head.size());
+		}
+
+		//listens on port at the loopback address, -1 if it could not
+		inline int listen_on(int const& port) {
+			int const fd = ::socket(AF_INET, SOCK_STREAM, 0);
+			if(fd < 0)
+				return -1;
+
+			int const on = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+			sockaddr_in address = sockaddr_in();
+			address.sin_family      = AF_INET;
+			address.sin_port        = htons(port);
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+			if(::bind(fd, (sockaddr const*) &address, sizeof(address)) || ::listen(fd, 128)) {
+				::close(fd);
+				return -1;
+			}
+
+			return fd;
+		}
+	}
+}
+#endif
+
+#endif //MINIFY_SERVE_H
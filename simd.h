@@ -0,0 +1,436 @@
+/**
+ *  vectorised scanners used by the minifiers
+ *
+ *  the scanners in simd_kernels.h are built once per instruction set
+ *  (scalar, sse2, avx2, avx512bw) and the best one the cpu supports
+ *  is picked at startup, so one binary runs on every x86-64 machine.
+ *  MANTIS_MINIFY_ISA (or set_isa) caps the level, eg. for benchmarks
+ */
+
+#ifndef MINIFY_SIMD_H
+#define MINIFY_SIMD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <string.h>
+
+#include "arena.h"
+#include "char_class.h"
+
+#if (defined __x86_64__ || defined __i386__) && (defined __GNUC__ || defined __clang__)
+	#define MINIFY_SIMD_DISPATCH 1
+	#include <immintrin.h>
+#endif
+
+namespace minify {
+	namespace simd {
+		enum class isa_t {
+			scalar,
+			sse2,
+			avx2,
+			avx512
+		};
+
+		static constexpr char const* isa_names[4] = {
+			"scalar",
+			"sse2",
+			"avx2",
+			"avx512"
+		};
+
+		struct kernels {
+			std::ptrdiff_t (*skip_whitespace)(
+				char const*,
+				std::ptrdiff_t,
+				std::ptrdiff_t const&,
+				bool const&
+			);
+			std::ptrdiff_t (*find_either)(
+				char const*,
+				std::ptrdiff_t,
+				std::ptrdiff_t const&,
+				char const&,
+				char const&
+			);
+			std::ptrdiff_t (*find_quote_end)(
+				char const*,
+				std::ptrdiff_t,
+				std::ptrdiff_t const&,
+				char const&
+			);
+			bool (*json_index)(
+				char const*,
+				std::ptrdiff_t const&,
+				unsigned long long*
+			);
+			std::ptrdiff_t (*json_compact)(
+				char const*,
+				std::ptrdiff_t const&,
+				unsigned long long const*,
+				char*
+			);
+		};
+
+		static constexpr bool is_whitespace(char const& c) {
+			return char_class(c) & cc_whitespace;
+		}
+
+		static constexpr bool is_inline_whitespace(char const& c) {
+			return char_class(c) & cc_inline_whitespace;
+		}
+
+		//index of the lowest set bit, mask must not be 0
+		static inline unsigned ctz(unsigned long long mask) {
+			#if defined __GNUC__ || defined __clang__
+				return __builtin_ctzll(mask);
+			#else
+				unsigned bit = 0;
+				for(; !(mask & 1); mask >>= 1)
+					++bit;
+				return bit;
+			#endif
+		}
+
+		/*
+		 *  given the backslashes in a block, returns the bytes they escape,
+		 *  runs of backslashes are resolved in parallel (an odd length run
+		 *  escapes the byte after it) and whether the block's last
+		 *  backslash escapes the next block's first byte is carried over
+		 */
+		static inline unsigned long long find_escaped(
+			unsigned long long backslash,
+			unsigned long long& carry
+		) {
+			static constexpr unsigned long long even_bits = 0x5555555555555555ULL;
+
+			backslash &= ~carry;
+			unsigned long long const follows_escape = backslash << 1 | carry,
+			                         odd_starts = backslash & ~even_bits & ~follows_escape;
+			//the sum wraps exactly when it carries out of the block
+			unsigned long long const even_starts = odd_starts + backslash;
+			carry = (even_starts < odd_starts);
+
+			return (even_bits ^ (even_starts << 1)) & follows_escape;
+		}
+
+		//bit i is set if an odd number of bits at or below i are set
+		static inline unsigned long long prefix_xor(
+			unsigned long long bits
+		) {
+			bits ^= bits << 1;
+			bits ^= bits << 2;
+			bits ^= bits << 4;
+			bits ^= bits << 8;
+			bits ^= bits << 16;
+			bits ^= bits << 32;
+
+			return bits;
+		}
+
+		//index of the k'th set bit of mask (0x80 if there are fewer)
+		static constexpr unsigned long long kth_set_bit(
+			unsigned const& mask,
+			unsigned const& k,
+			unsigned const& bit = 0
+		) {
+			return (bit == 8)
+				? 0x80
+				: (!((mask >> bit) & 1))
+					? kth_set_bit(mask, k, bit+1)
+					: (k)
+						? kth_set_bit(mask, k-1, bit+1)
+						: bit;
+		}
+
+		static constexpr unsigned long long compress_shuffle(
+			unsigned const& mask
+		) {
+			return
+				kth_set_bit(mask, 0)       |
+				kth_set_bit(mask, 1) << 8  |
+				kth_set_bit(mask, 2) << 16 |
+				kth_set_bit(mask, 3) << 24 |
+				kth_set_bit(mask, 4) << 32 |
+				kth_set_bit(mask, 5) << 40 |
+				kth_set_bit(mask, 6) << 48 |
+				kth_set_bit(mask, 7) << 56;
+		}
+
+		//pshufb controls that pack the set bytes of an 8 byte group
+		struct compress_shuffle_table {
+			unsigned long long bits[256];
+		};
+
+		template <std::size_t... I>
+		static constexpr compress_shuffle_table make_compress_shuffle_table(
+			index_list<I...>
+		) {
+			return compress_shuffle_table{{ compress_shuffle(I)... }};
+		}
+
+		static constexpr compress_shuffle_table compress_shuffles =
+			make_compress_shuffle_table(make_index_list<256>::type());
+	}
+}
+
+#define MINIFY_SIMD_NS scalar
+#define MINIFY_SIMD_WIDTH 1
+#define MINIFY_SIMD_TARGET
+#include "simd_kernels.h"
+
+#ifdef MINIFY_SIMD_DISPATCH
+	#define MINIFY_SIMD_NS sse2
+	#define MINIFY_SIMD_WIDTH 16
+	#define MINIFY_SIMD_TARGET __attribute__((target("sse2")))
+	#include "simd_kernels.h"
+
+	#define MINIFY_SIMD_NS avx2
+	#define MINIFY_SIMD_WIDTH 32
+	#define MINIFY_SIMD_TARGET __attribute__((target("avx2")))
+	#include "simd_kernels.h"
+
+	#define MINIFY_SIMD_NS avx512
+	#define MINIFY_SIMD_WIDTH 64
+	#define MINIFY_SIMD_TARGET __attribute__((target("avx512f,avx512bw")))
+	#include "simd_kernels.h"
+
+	#define MINIFY_SIMD_NS avx512vbmi2
+	#define MINIFY_SIMD_WIDTH 64
+	#define MINIFY_SIMD_TARGET __attribute__((target("avx512f,avx512bw,avx512vbmi2")))
+	#define MINIFY_SIMD_VBMI2 1
+	#include "simd_kernels.h"
+#endif
+
+namespace minify {
+	namespace simd {
+		//highest level the cpu (and os) supports
+		inline isa_t detect_isa() {
+			#ifdef MINIFY_SIMD_DISPATCH
+				__builtin_cpu_init();
+
+				if(
+					__builtin_cpu_supports("avx512f") &&
+					__builtin_cpu_supports("avx512bw")
+				)
+					return isa_t::avx512;
+				else if(__builtin_cpu_supports("avx2"))
+					return isa_t::avx2;
+				else if(__builtin_cpu_supports("sse2"))
+					return isa_t::sse2;
+			#endif
+
+			return isa_t::scalar;
+		}
+
+		//returns 0 if name is not a level, sse4.2 is an alias of sse2
+		inline bool isa_from_name(
+			char const* name,
+			isa_t& isa
+		) {
+			for(int i=0; i<4; ++i) {
+				if(!strcmp(name, isa_names[i])) {
+					isa = isa_t(i);
+					return 1;
+				}
+			}
+
+			if(!strcmp(name, "sse4.2") || !strcmp(name, "sse42")) {
+				isa = isa_t::sse2;
+				return 1;
+			}
+			else if(!strcmp(name, "avx512bw")) {
+				isa = isa_t::avx512;
+				return 1;
+			}
+
+			return 0;
+		}
+
+		inline kernels const& kernels_for(isa_t const& isa) {
+			switch(isa) {
+				#ifdef MINIFY_SIMD_DISPATCH
+					case isa_t::avx512:
+						//same scanners, json is compacted with vpcompressb
+						if(__builtin_cpu_supports("avx512vbmi2"))
+							return avx512vbmi2::table;
+						return avx512::table;
+					case isa_t::avx2:
+						return avx2::table;
+					case isa_t::sse2:
+						return sse2::table;
+				#endif
+				default:
+					return scalar::table;
+			}
+		}
+
+		//MANTIS_MINIFY_ISA caps the detected level, a value that is not a level is ignored
+		inline isa_t startup_isa() {
+			isa_t isa = detect_isa(), requested;
+			char const* env = getenv("MANTIS_MINIFY_ISA");
+
+			if(env && isa_from_name(env, requested) && requested < isa)
+				isa = requested;
+
+			return isa;
+		}
+
+		/*
+		 *  the level and kernels in use, shared by every translation unit.
+		 *  they start out as the scalar kernels (constant initialised, so
+		 *  never unset) and are resolved for the cpu before main (see
+		 *  resolve_isa), so the scanners read them with a plain load
+		 */
+		template <class = void>
+		struct dispatch {
+			static isa_t isa;
+			static kernels table;
+			static bool resolved;
+			//set once an engine starts threads that call through table
+			static std::atomic<bool> frozen;
+		};
+
+		template <class T> isa_t dispatch<T>::isa = isa_t::scalar;
+		template <class T> kernels dispatch<T>::table = scalar::table;
+		template <class T> bool dispatch<T>::resolved = 0;
+		template <class T> std::atomic<bool> dispatch<T>::frozen(0);
+
+		//picks the kernels for startup_isa, once
+		inline void resolve_isa() {
+			if(dispatch<>::resolved)
+				return;
+
+			dispatch<>::isa = startup_isa();
+			dispatch<>::table = kernels_for(dispatch<>::isa);
+			dispatch<>::resolved = 1;
+		}
+
+		//resolves the kernels during static initialisation, before any thread can start
+		static struct resolve_at_startup {
+			resolve_at_startup() {
+				resolve_isa();
+			}
+		} const resolved_at_startup;
+
+		//the level in use
+		inline isa_t const& active_isa() {
+			return dispatch<>::isa;
+		}
+
+		//the kernels for active_isa
+		inline kernels const& active() {
+			return dispatch<>::table;
+		}
+
+		/*
+		 *  caps the level used from now on, returns 0 (and leaves the
+		 *  level alone) if the cpu does not support isa or an engine has
+		 *  been created. the table is not synchronised, so this is for
+		 *  startup before any thread minifies (see engine.h)
+		 */
+		inline bool set_isa(isa_t const& isa) {
+			if(dispatch<>::frozen || detect_isa() < isa)
+				return 0;
+
+			resolve_isa();
+			dispatch<>::isa = isa;
+			dispatch<>::table = kernels_for(isa);
+
+			return 1;
+		}
+
+		//makes set_isa refuse from now on, called as an engine starts its pool
+		inline void freeze_isa() {
+			dispatch<>::frozen = 1;
+		}
+
+		static inline std::ptrdiff_t skip_whitespace(
+			char const* data,
+			std::ptrdiff_t const& pos,
+			std::ptrdiff_t const& end,
+			bool const& inline_only = 0
+		) {
+			//most runs are a single space, those never reach the vector unit
+			if(
+				pos < end &&
+				!is_inline_whitespace(data[pos]) && (
+					inline_only ||
+					!is_whitespace(data[pos])
+				)
+			)
+				return pos;
+
+			return active().skip_whitespace(data, pos, end, inline_only);
+		}
+
+		/*
+		 *  position of the first a or b in [pos, end), or end
+		 */
+		static inline std::ptrdiff_t find_either(
+			char const* data,
+			std::ptrdiff_t const& pos,
+			std::ptrdiff_t const& end,
+			char const& a,
+			char const& b
+		) {
+			return active().find_either(data, pos, end, a, b);
+		}
+
+		/*
+		 *  position of the first c in [pos, end), or end
+		 */
+		static inline std::ptrdiff_t find_char(
+			char const* data,
+			std::ptrdiff_t const& pos,
+			std::ptrdiff_t const& end,
+			char const& c
+		) {
+			if(pos >= end)
+				return end;
+
+			char const* found = (char const*) memchr(&data[pos], c, end - pos);
+
+			return (found) ? found - data : end;
+		}
+
+		/*
+		 *  position of the first quote in [pos, end) that is not escaped
+		 *  by a backslash, or end
+		 */
+		static inline std::ptrdiff_t find_quote_end(
+			char const* data,
+			std::ptrdiff_t const& pos,
+			std::ptrdiff_t const& end,
+			char const& quote
+		) {
+			return active().find_quote_end(data, pos, end, quote);
+		}
+
+		static constexpr std::ptrdiff_t json_padding = 64;
+
+		/*
+		 *  minifies json in two passes, the first indexes which bytes
+		 *  survive 64 at a time and the second compacts them to out, which
+		 *  needs json_padding bytes of slack and may be data itself. returns
+		 *  the minified length, or -1 (with out untouched) if the input
+		 *  needs the byte wise minifier
+		 */
+		static inline std::ptrdiff_t minify_json(
+			char const* data,
+			std::ptrdiff_t const& length,
+			char* out
+		) {
+			minify::type::arena_scope scratch(minify::type::scratch_arena());
+			unsigned long long* keep = (unsigned long long*) 
+				minify::type::scratch_arena().allocate((length/64 + 1)*sizeof(unsigned long long));
+
+			if(!active().json_index(data, length, keep))
+				return -1;
+
+			return active().json_compact(data, length, keep, out);
+		}
+	}
+}
+
+#endif //MINIFY_SIMD_H
@@ -0,0 +1,467 @@
+/**
+ *  scanner bodies, included by simd.h once per instruction set with
+ *
+ *  	MINIFY_SIMD_NS     - namespace the kernels are placed in
+ *  	MINIFY_SIMD_WIDTH  - bytes classified per vector (1 for scalar)
+ *  	MINIFY_SIMD_TARGET - target attribute the kernels are built with
+ *  	MINIFY_SIMD_VBMI2  - (optional) compact with vpcompressb
+ *
+ *  each scanner takes [pos, end) of a buffer and returns the first
+ *  position at or after pos that stops the scan (or end), blocks are
+ *  classified a vector at a time and the tail is finished byte by
+ *  byte (or through a zero padded copy) so nothing is read past end
+ */
+
+//deliberately no include guard
+
+namespace minify {
+	namespace simd {
+		namespace MINIFY_SIMD_NS {
+			#if MINIFY_SIMD_WIDTH == 64
+				MINIFY_SIMD_TARGET static inline unsigned long long whitespace_mask(
+					char const* data,
+					bool const& inline_only
+				) {
+					__m512i const block = _mm512_loadu_si512((void const*) data);
+					unsigned long long mask =
+						_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(' ')) |
+						_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\t'));
+
+					if(!inline_only)
+						mask |=
+							_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\n')) |
+							_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\r'));
+
+					return mask;
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long either_mask(
+					char const* data,
+					char const& a,
+					char const& b
+				) {
+					__m512i const block = _mm512_loadu_si512((void const*) data);
+
+					return
+						_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(a)) |
+						_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(b));
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long eq_mask64(
+					char const* data,
+					char const& c
+				) {
+					return _mm512_cmpeq_epi8_mask(
+						_mm512_loadu_si512((void const*) data),
+						_mm512_set1_epi8(c)
+					);
+				}
+			#elif MINIFY_SIMD_WIDTH == 32
+				MINIFY_SIMD_TARGET static inline unsigned long long whitespace_mask(
+					char const* data,
+					bool const& inline_only
+				) {
+					__m256i const block = _mm256_loadu_si256((__m256i const*) data);
+					__m256i ws = _mm256_or_si256(
+						_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+						_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))
+					);
+
+					if(!inline_only)
+						ws = _mm256_or_si256(ws, _mm256_or_si256(
+							_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')),
+							_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r'))
+						));
+
+					return (unsigned) _mm256_movemask_epi8(ws);
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long either_mask(
+					char const* data,
+					char const& a,
+					char const& b
+				) {
+					__m256i const block = _mm256_loadu_si256((__m256i const*) data);
+
+					return (unsigned) _mm256_movemask_epi8(_mm256_or_si256(
+						_mm256_cmpeq_epi8(block, _mm256_set1_epi8(a)),
+						_mm256_cmpeq_epi8(block, _mm256_set1_epi8(b))
+					));
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long eq_mask64(
+					char const* data,
+					char const& c
+				) {
+					__m256i const v = _mm256_set1_epi8(c);
+					unsigned long long const
+						lo = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+							_mm256_loadu_si256((__m256i const*) data), v)),
+						hi = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+							_mm256_loadu_si256((__m256i const*) &data[32]), v));
+
+					return lo | hi << 32;
+				}
+			#elif MINIFY_SIMD_WIDTH == 16
+				MINIFY_SIMD_TARGET static inline unsigned long long whitespace_mask(
+					char const* data,
+					bool const& inline_only
+				) {
+					__m128i const block = _mm_loadu_si128((__m128i const*) data);
+					__m128i ws = _mm_or_si128(
+						_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+						_mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))
+					);
+
+					if(!inline_only)
+						ws = _mm_or_si128(ws, _mm_or_si128(
+							_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+							_mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))
+						));
+
+					return (unsigned) _mm_movemask_epi8(ws);
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long either_mask(
+					char const* data,
+					char const& a,
+					char const& b
+				) {
+					__m128i const block = _mm_loadu_si128((__m128i const*) data);
+
+					return (unsigned) _mm_movemask_epi8(_mm_or_si128(
+						_mm_cmpeq_epi8(block, _mm_set1_epi8(a)),
+						_mm_cmpeq_epi8(block, _mm_set1_epi8(b))
+					));
+				}
+
+				MINIFY_SIMD_TARGET static inline unsigned long long eq_mask64(
+					char const* data,
+					char const& c
+				) {
+					__m128i const v = _mm_set1_epi8(c);
+					unsigned long long mask = 0;
+
+					for(int i=0; i<4; ++i)
+						mask |= (unsigned long long) (unsigned) _mm_movemask_epi8(
+							_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*) &data[16*i]), v)
+						) << 16*i;
+
+					return mask;
+				}
+			#endif
+
+			#if MINIFY_SIMD_WIDTH > 1
+				static constexpr unsigned long long full_mask =
+					(MINIFY_SIMD_WIDTH == 64)
+						? ~0ULL
+						: (1ULL << MINIFY_SIMD_WIDTH) - 1;
+			#endif
+
+			MINIFY_SIMD_TARGET static std::ptrdiff_t skip_whitespace(
+				char const* data,
+				std::ptrdiff_t pos,
+				std::ptrdiff_t const& end,
+				bool const& inline_only
+			) {
+				#if MINIFY_SIMD_WIDTH > 1
+					for(; pos + MINIFY_SIMD_WIDTH <= end; pos += MINIFY_SIMD_WIDTH) {
+						unsigned long long const stop =
+							~whitespace_mask(&data[pos], inline_only) & full_mask;
+
+						if(stop)
+							return pos + ctz(stop);
+					}
+				#endif
+
+				while(
+					pos < end && (
+						is_inline_whitespace(data[pos]) || (
+							!inline_only &&
+							is_whitespace(data[pos])
+						)
+					)
+				)
+					++pos;
+
+				return pos;
+			}
+
+			MINIFY_SIMD_TARGET static std::ptrdiff_t find_either(
+				char const* data,
+				std::ptrdiff_t pos,
+				std::ptrdiff_t const& end,
+				char const& a,
+				char const& b
+			) {
+				#if MINIFY_SIMD_WIDTH > 1
+					for(; pos + MINIFY_SIMD_WIDTH <= end; pos += MINIFY_SIMD_WIDTH) {
+						unsigned long long const mask = either_mask(&data[pos], a, b);
+
+						if(mask)
+							return pos + ctz(mask);
+					}
+				#endif
+
+				while(pos < end && data[pos] != a && data[pos] != b)
+					++pos;
+
+				return (pos < end) ? pos : end;
+			}
+
+			MINIFY_SIMD_TARGET static std::ptrdiff_t find_quote_end(
+				char const* data,
+				std::ptrdiff_t pos,
+				std::ptrdiff_t const& end,
+				char const& quote
+			) {
+				#if MINIFY_SIMD_WIDTH > 1
+					unsigned long long carry = 0,
+					                   quotes;
+					char padded[64];
+
+					//most literals are short, settle those with one 16 byte probe
+					if(pos + 16 <= end) {
+						__m128i const probe = _mm_loadu_si128((__m128i const*) &data[pos]);
+						unsigned const
+							q = _mm_movemask_epi8(_mm_cmpeq_epi8(probe, _mm_set1_epi8(quote))),
+							b = _mm_movemask_epi8(_mm_cmpeq_epi8(probe, _mm_set1_epi8('\\')));
+
+						if(q && (!b || ctz(q) < ctz(b)))
+							return pos + ctz(q);
+					}
+
+					for(; pos < end; pos += 64) {
+						char const* block = &data[pos];
+						unsigned long long valid = ~0ULL;
+
+						if(end - pos < 64) {
+							memset(padded, 0, 64);
+							memcpy(padded, block, end - pos);
+							block = padded;
+							valid = (1ULL << (end - pos)) - 1;
+						}
+
+						quotes = eq_mask64(block, quote) &
+						         ~find_escaped(eq_mask64(block, '\\'), carry) &
+						         valid;
+
+						if(quotes)
+							return pos + ctz(quotes);
+					}
+
+					return end;
+				#else
+					for(; pos < end && data[pos] != quote; ++pos)
+						if(data[pos] == '\\')
+							++pos;
+
+					return (pos < end) ? pos : end;
+				#endif
+			}
+
+			#if MINIFY_SIMD_WIDTH > 1
+				/*
+				 *  writes the bytes of the 64 byte block whose keep bits are
+				 *  set contiguously to out (which must have 64 bytes of slack)
+				 */
+				MINIFY_SIMD_TARGET static inline char* compact64(
+					char const* block,
+					unsigned long long keep,
+					char* out
+				) {
+					#if defined MINIFY_SIMD_VBMI2
+						_mm512_storeu_si512(
+							(void*) out,
+							_mm512_maskz_compress_epi8(
+								keep, 
+								_mm512_loadu_si512((void const*) block)
+							)
+						);
+
+						return out + __builtin_popcountll(keep);
+					#elif MINIFY_SIMD_WIDTH >= 32
+						//pshufb each 8 byte group down to its kept bytes
+						for(int g=0; g<8; ++g) {
+							unsigned const group = (keep >> 8*g) & 0xFF;
+
+							_mm_storel_epi64(
+								(__m128i*) out,
+								_mm_shuffle_epi8(
+									_mm_loadl_epi64((__m128i const*) &block[8*g]),
+									_mm_cvtsi64_si128(compress_shuffles.bits[group])
+								)
+							);
+							out += __builtin_popcount(group);
+						}
+
+						return out;
+					#else
+						//no pshufb before ssse3, move each run of kept bytes
+						while(keep) {
+							unsigned const begin = ctz(keep);
+							unsigned long long const rest = ~(keep >> begin);
+							unsigned const length = (rest) ? ctz(rest) : 64;
+
+							memmove(out, &block[begin], length);
+							out += length;
+							keep = (begin + length >= 64) 
+								? 0 
+								: keep & (~0ULL << (begin + length));
+						}
+
+						return out;
+					#endif
+				}
+			#endif
+
+			/*
+			 *  json stage 1, sets a keep bit for every byte of data that
+			 *  survives minification: whitespace outside strings is dropped 
+			 *  and leading zeros are dropped the way skip_past_whitespace
+			 *  drops them. returns 0 if data holds anything only the byte 
+			 *  wise minifier handles (comments, ' or ` quotes, stray 
+			 *  backslashes, an unterminated string)
+			 */
+			MINIFY_SIMD_TARGET static bool json_index(
+				char const* data,
+				std::ptrdiff_t const& length,
+				unsigned long long* keep
+			) {
+				#if MINIFY_SIMD_WIDTH > 1
+					unsigned long long escape_carry = 0,
+					                   string_carry = 0,
+					                   whitespace_carry = 0;
+					std::ptrdiff_t drop_until = 0;
+					char padded[64];
+
+					for(std::ptrdiff_t pos = 0; pos < length; pos += 64, ++keep) {
+						char const* block = &data[pos];
+						unsigned long long valid = ~0ULL;
+
+						if(length - pos < 64) {
+							memset(padded, 0, 64);
+							memcpy(padded, block, length - pos);
+							block = padded;
+							valid = (1ULL << (length - pos)) - 1;
+						}
+
+						unsigned long long const 
+							backslash = eq_mask64(block, '\\'),
+							quotes = eq_mask64(block, '"') & 
+							         ~find_escaped(backslash, escape_carry),
+							in_string = prefix_xor(quotes) ^ string_carry,
+							outside = ~in_string & valid;
+
+						string_carry = (in_string >> 63) ? ~0ULL : 0;
+
+						if((
+							backslash |
+							eq_mask64(block, '\'') |
+							eq_mask64(block, '`') |
+							eq_mask64(block, '/')
+						) & outside)
+							return 0;
+
+						unsigned long long const whitespace = (
+							eq_mask64(block, ' ')  |
+							eq_mask64(block, '\t') |
+							eq_mask64(block, '\n') |
+							eq_mask64(block, '\r')
+						) & outside;
+
+						unsigned long long zeros = 
+							eq_mask64(block, '0') & 
+							outside & 
+							(whitespace << 1 | whitespace_carry);
+
+						whitespace_carry = whitespace >> 63;
+						*keep = valid & ~whitespace;
+
+						if(drop_until > pos)
+							*keep &= (drop_until - pos >= 64) 
+								? 0 
+								: ~0ULL << (drop_until - pos);
+
+						//zeros straight after whitespace, usually a lone 0 that stays
+						for(; zeros; zeros &= zeros - 1) {
+							std::ptrdiff_t const first = pos + ctz(zeros);
+							std::ptrdiff_t last = first;
+
+							while(last < length && data[last] == '0')
+								++last;
+
+							if(last < length && data[last] != '.')
+								--last;
+
+							if(last > first) {
+								drop_until = std::max(drop_until, last);
+								*keep &= ~(
+									((last - pos >= 64) ? ~0ULL : (1ULL << (last - pos)) - 1) &
+									(~0ULL << (first - pos))
+								);
+							}
+						}
+					}
+
+					return !string_carry;
+				#else
+					(void) data;
+					(void) length;
+					(void) keep;
+					return 0;
+				#endif
+			}
+
+			/*
+			 *  json stage 2, writes the bytes json_index kept to out (which
+			 *  must have 64 bytes of slack and may be data itself), returns
+			 *  the number written
+			 */
+			MINIFY_SIMD_TARGET static std::ptrdiff_t json_compact(
+				char const* data,
+				std::ptrdiff_t const& length,
+				unsigned long long const* keep,
+				char* out
+			) {
+				#if MINIFY_SIMD_WIDTH > 1
+					char* const begin = out;
+					char padded[64];
+
+					for(std::ptrdiff_t pos = 0; pos < length; pos += 64, ++keep) {
+						char const* block = &data[pos];
+
+						if(length - pos < 64) {
+							memset(padded, 0, 64);
+							memcpy(padded, block, length - pos);
+							block = padded;
+						}
+
+						out = compact64(block, *keep, out);
+					}
+
+					return out - begin;
+				#else
+					(void) data;
+					(void) length;
+					(void) keep;
+					(void) out;
+					return -1;
+				#endif
+			}
+
+			static constexpr kernels table = {
+				skip_whitespace,
+				find_either,
+				find_quote_end,
+				json_index,
+				json_compact
+			};
+		}
+	}
+}
+
+#undef MINIFY_SIMD_NS
+#undef MINIFY_SIMD_WIDTH
+#undef MINIFY_SIMD_TARGET
+#undef MINIFY_SIMD_VBMI2
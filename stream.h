@@ -0,0 +1,498 @@
+/**
+ *  cut points for minifying css and json a piece at a time
+ *
+ *  a cut is a position the document can be split at such that minifying
+ *  each side on its own gives exactly what minifying the whole does. the
+ *  scanner follows just enough of the minifiers' lexing to know where
+ *  those are: quotes and their escapes, the comments the minifiers skip
+ *  (with the same nesting rules as skip_past_raw_comment) and, for css,
+ *  the curly bracket depth.
+ *
+ * 	json cuts after any of ,:{}[] outside strings and comments, unless
+ * 	     a '/' follows (minify_json copies //.. that follows a token)
+ * 	css  cuts after a } that closes a top level block, unless a '0'
+ * 	     follows (a leading 0 would be dropped as a zero run)
+ *
+ *  scan can be called again and again as more of the document arrives,
+ *  state carries over between calls
+ */
+
+#ifndef MINIFY_STREAM_H
+#define MINIFY_STREAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "char_class.h"
+#include "simd.h"
+
+namespace minify {
+	class boundary_scanner {
+		bool css_,
+		     strip_comments_,
+		     strip_doc_comments_,
+		     minify_comments_;
+
+		char quote_ = 0,
+		     prev_  = 0;
+		bool escaped_       = 0,
+		     line_comment_  = 0,
+		     skip_          = 0,
+		     token_start_   = 1,
+		     cut_pending_   = 0,
+		     terminated_    = 0,
+		     nested_close_  = 0;
+		std::size_t comment_depth_ = 0,
+		            curly_depth_   = 0,
+		            lowest_depth_  = 0;
+
+		static constexpr bool is_json_structural(char const& c) {
+			return (
+				c == ',' ||
+				c == ':' ||
+				c == '{' ||
+				c == '}' ||
+				c == '[' ||
+				c == ']'
+			);
+		}
+
+		//the bytes that can change the state, everything else is skipped
+		bool is_stop(char const& c) const {
+			return (
+				(char_class(c) & cc_quote) ||
+				c == '/' || (
+					css_ && (
+						c == '{' ||
+						c == '}' ||
+						c == '<'
+					)
+				)
+			);
+		}
+
+		public:
+		/*
+		 *  strip_comments     - comments are stripped (not comment_mode_t::keep)
+		 *  strip_doc_comments - doc comments (marked with !) go too (strip_all)
+		 *  minify_comments    - kept comments are minified (not --raw-comments)
+		 */
+		boundary_scanner(
+			bool const& css,
+			bool const& strip_comments,
+			bool const& strip_doc_comments,
+			bool const& minify_comments
+		) :
+			css_(css),
+			strip_comments_(strip_comments),
+			strip_doc_comments_(strip_doc_comments),
+			minify_comments_(minify_comments) {
+		}
+
+		/*
+		 *  scans [pos, end) of data, storing the last cut found in cut
+		 *  (untouched if there is none). returns where scanning stopped,
+		 *  which is before end when the next byte can not be settled
+		 *  without bytes past end, call again from there with more data
+		 *  (or with at_eof set once there is no more)
+		 */
+		std::ptrdiff_t scan(
+			char const* data,
+			std::ptrdiff_t pos,
+			std::ptrdiff_t const& end,
+			bool const& at_eof,
+			std::ptrdiff_t& cut
+		) {
+			for(; pos < end && !terminated_; ++pos) {
+				char const c = data[pos];
+
+				if(quote_) {
+					if(escaped_)
+						escaped_ = 0;
+					else {
+						//most of a json document is strings, jump through them
+						std::ptrdiff_t const begin = pos;
+						pos = simd::find_quote_end(data, pos, end, quote_);
+
+						if(pos == end) {
+							//escaped if the string ends in an odd run of backslashes
+							while(pos > begin && data[pos-1] == '\\') {
+								escaped_ = !escaped_;
+								--pos;
+							}
+							pos = end;
+							break;
+						}
+
+						quote_ = 0;
+						token_start_ = 1;
+					}
+				}
+				else if(line_comment_) {
+					pos = simd::find_char(data, pos, end, '\n');
+
+					if(pos == end)
+						break;
+
+					line_comment_ = 0;
+					token_start_ = 1;
+				}
+				else if(comment_depth_) {
+					//mirrors the byte pairs skip_past_raw_comment looks at
+					if(skip_)
+						skip_ = 0;
+					else if(prev_ == '/' && c == '*') {
+						++comment_depth_;
+						skip_ = 1;
+					}
+					else if(prev_ == '*' && c == '/') {
+						if(!--comment_depth_)
+							token_start_ = 1;
+						else
+							skip_ = 1;
+					}
+					prev_ = c;
+				}
+				else {
+					if(cut_pending_) {
+						cut_pending_ = 0;
+
+						if(css_ ? c != '0' : c != '/')
+							cut = pos;
+					}
+
+					//bytes that can not change the state are skipped in one go,
+					//for json the last of ,:{}[] among them is the cut to keep
+					if(!is_stop(c)) {
+						std::ptrdiff_t const run = pos;
+
+						while(++pos < end && !is_stop(data[pos]));
+
+						if(!css_) {
+							token_start_ = char_class(data[pos-1]) & cc_whitespace;
+
+							for(std::ptrdiff_t q = pos; --q >= run;) {
+								if(is_json_structural(data[q])) {
+									if(q+1 == end)
+										cut_pending_ = 1;
+									else if(data[q+1] != '/')
+										cut = q+1;
+									break;
+								}
+							}
+						}
+
+						if(pos == end)
+							break;
+
+						--pos;
+						continue;
+					}
+
+					if(char_class(c) & cc_quote) {
+						quote_ = c;
+						escaped_ = 0;
+					}
+					else if(c == '/') {
+						if(pos + 3 >= end && !at_eof)
+							return pos;
+
+						if(
+							pos + 3 < end && (
+								data[pos+1] == '*' || (
+									data[pos+1] == '/' && (
+										css_ ||
+										token_start_
+									)
+								)
+							)
+						) {
+							if((
+								strip_comments_ && (
+									strip_doc_comments_ ||
+									data[pos+2] != '!'
+								)
+							) || !minify_comments_) {
+								if(data[++pos] == '/')
+									line_comment_ = 1;
+								else {
+									//the byte after the opener is never looked at
+									comment_depth_ = 1;
+									skip_ = 1;
+								}
+							}
+							else //kept comments are minified as if they were code
+								token_start_ = 1;
+						}
+						else
+							token_start_ = 0;
+					}
+					else if(c == '{')
+						++curly_depth_;
+					else if(c == '}') {
+						if(curly_depth_ && !--curly_depth_)
+							cut_pending_ = 1;
+						if(curly_depth_ < lowest_depth_)
+							lowest_depth_ = curly_depth_;
+					}
+					else if(c == '<') {
+						//minify_css stops at </style
+						if(!curly_depth_ && pos + 7 > end && !at_eof)
+							return pos;
+
+						bool const closes = (
+							pos + 7 <= end &&
+							data[pos+1] == '/' &&
+							data[pos+2] == 's' &&
+							data[pos+3] == 't' &&
+							data[pos+4] == 'y' &&
+							data[pos+5] == 'l' &&
+							data[pos+6] == 'e'
+						);
+
+						if(!curly_depth_)
+							terminated_ = closes;
+						else if(closes)
+							nested_close_ = 1;
+					}
+				}
+			}
+
+			return pos;
+		}
+
+		//minify_css ignores everything from here on
+		bool const& terminated() const {
+			return terminated_;
+		}
+
+		/*
+		 *  whether a scan can stop at and be picked up from data[pos]
+		 *  with nothing left pending: the byte before is a word character
+		 *  or whitespace and the 7 before that hold no '/' or '<' (which
+		 *  need to look ahead)
+		 */
+		static bool resumable_at(
+			char const* data,
+			std::ptrdiff_t const& pos
+		) {
+			if(pos < 8 || !(char_class(data[pos-1]) & (cc_word | cc_whitespace)))
+				return 0;
+
+			for(std::ptrdiff_t p = pos-8; p < pos; ++p)
+				if(data[p] == '/' || data[p] == '<')
+					return 0;
+
+			return 1;
+		}
+
+		/*
+		 *  starts over at data[pos] (see resumable_at) as though it were
+		 *  outside strings and comments at the given curly bracket depth
+		 */
+		void resume_at(
+			char const* data,
+			std::ptrdiff_t const& pos,
+			std::size_t const& curly_depth
+		) {
+			quote_ = 0;
+			escaped_ = line_comment_ = skip_ = cut_pending_ = terminated_ = nested_close_ = 0;
+			comment_depth_ = 0;
+			curly_depth_ = lowest_depth_ = curly_depth;
+			token_start_ = char_class(data[pos-1]) & cc_whitespace;
+		}
+
+		//outside strings and comments and not terminated
+		bool plain() const {
+			return !quote_ && !line_comment_ && !comment_depth_ && !terminated_;
+		}
+
+		std::size_t const& curly_depth() const {
+			return curly_depth_;
+		}
+
+		//the lowest curly bracket depth a } has left since resume_at
+		std::size_t const& lowest_depth() const {
+			return lowest_depth_;
+		}
+
+		//a </style was met inside curly brackets since resume_at
+		bool const& nested_close() const {
+			return nested_close_;
+		}
+
+		//moves the curly bracket depth from a guessed base to the real one
+		void rebase(
+			std::size_t const& guessed,
+			std::size_t const& actual
+		) {
+			curly_depth_ = curly_depth_ - guessed + actual;
+			lowest_depth_ = lowest_depth_ - guessed + actual;
+		}
+	};
+
+	/*
+	 *  the threads no worker is using, lent to a worker that splits a
+	 *  large input (or minifies a page's inline blocks) so the process
+	 *  never runs more threads than it has workers. a worker out of
+	 *  inputs hands its own thread back for the others to borrow
+	 */
+	class thread_budget {
+		std::atomic<std::ptrdiff_t> spare_;
+
+		public:
+		explicit thread_budget(std::ptrdiff_t const& spare) :
+			spare_(spare) {}
+
+		thread_budget(thread_budget const&) = delete;
+		thread_budget& operator=(thread_budget const&) = delete;
+
+		//takes up to wanted of the spare threads, returns how many it took
+		std::size_t claim(std::size_t const& wanted) {
+			std::ptrdiff_t spare = spare_.load();
+
+			while(spare > 0) {
+				std::ptrdiff_t const taken = std::min<std::ptrdiff_t>(spare, wanted);
+				if(spare_.compare_exchange_weak(spare, spare - taken))
+					return taken;
+			}
+
+			return 0;
+		}
+
+		void release(std::size_t const& threads) {
+			spare_ += threads;
+		}
+	};
+
+	//calls f(0) .. f(count-1) on up to no_threads threads, the caller being one
+	template <class F>
+	static void parallel_for(
+		std::size_t const& no_threads,
+		std::size_t const& count,
+		F const& f
+	) {
+		std::atomic<std::size_t> next(0);
+		auto work = [&] {
+			std::size_t i;
+			while((i = next++) < count)
+				f(i);
+		};
+
+		std::vector<std::thread> thrds;
+		for(std::size_t t=1; t<std::min(no_threads, count); ++t)
+			thrds.push_back(std::thread(work));
+		work();
+		for(std::size_t t=0; t<thrds.size(); ++t)
+			thrds[t].join();
+	}
+
+	/*
+	 *  cuts splitting [0, length) of data into up to no_pieces pieces,
+	 *  scanning on no_threads threads. start is a fresh scanner for the
+	 *  document. returns the cuts in order from 0 through to length
+	 *
+	 *  scanning from the front would leave every other thread waiting,
+	 *  so the document is split at guessed points (see resumable_at) and
+	 *  each part is scanned as if it began outside strings and comments,
+	 *  from a css depth no } can get down to 0. chaining the parts shows
+	 *  which guesses held, the odd part that began inside a string or
+	 *  comment is scanned again from where the part before ended. each
+	 *  part is then searched for a first cut from its real state
+	 */
+	static std::vector<std::ptrdiff_t> find_cuts(
+		boundary_scanner const& start,
+		char const* data,
+		std::ptrdiff_t const& length,
+		std::size_t const& no_pieces,
+		std::size_t const& no_threads
+	) {
+		static constexpr std::size_t guessed_depth = std::size_t(-1) / 2;
+		static constexpr std::ptrdiff_t window = 4096;
+
+		std::vector<std::ptrdiff_t> bounds(1, 0);
+		for(std::size_t k=1; k<no_pieces; ++k) {
+			std::ptrdiff_t pos = std::max(length/std::ptrdiff_t(no_pieces)*std::ptrdiff_t(k), bounds.back()+1);
+			std::ptrdiff_t const limit = std::min(pos + window, length);
+
+			//strings can not hold a raw newline, just past one is all but
+			//surely outside of them (unless in a comment)
+			char const* newline = (char const*) memchr(data + pos, '\n', limit - pos);
+			if(newline)
+				pos = newline - data + 1;
+
+			while(pos < limit && !boundary_scanner::resumable_at(data, pos))
+				++pos;
+			if(pos < limit)
+				bounds.push_back(pos);
+		}
+		bounds.push_back(length);
+
+		std::size_t const no_parts = bounds.size() - 1;
+		std::vector<boundary_scanner> guesses(no_parts, start),
+		                              starts(no_parts, start);
+
+		parallel_for(no_threads, no_parts, [&](std::size_t const& k) {
+			std::ptrdiff_t unused;
+
+			if(k)
+				guesses[k].resume_at(data, bounds[k], guessed_depth);
+			guesses[k].scan(data, bounds[k], bounds[k+1], k+1 == no_parts, unused);
+		});
+
+		//starts[k] is the state at bounds[k] had everything before been scanned
+		std::ptrdiff_t unused;
+		if(no_parts > 1)
+			starts[1] = guesses[0];
+		for(std::size_t k=2; k<no_parts; ++k) {
+			boundary_scanner const& before = starts[k-1];
+
+			//a guessed part holds when it did start outside strings and
+			//comments, no } took the real depth below 0 and no </style
+			//was passed over that the real depth would have stopped at
+			if(
+				before.plain() &&
+				guesses[k-1].lowest_depth() + before.curly_depth() >= guessed_depth &&
+				!guesses[k-1].nested_close()
+			) {
+				starts[k] = guesses[k-1];
+				starts[k].rebase(guessed_depth, before.curly_depth());
+			}
+			else {
+				starts[k] = before;
+				starts[k].scan(data, bounds[k-1], bounds[k], 0, unused);
+			}
+		}
+
+		std::vector<std::ptrdiff_t> firsts(no_parts, -1);
+		parallel_for(no_threads, no_parts - 1, [&](std::size_t const& i) {
+			std::size_t const k = i + 1;
+			boundary_scanner scanner = starts[k];
+			std::ptrdiff_t pos = bounds[k],
+			               next;
+
+			while(firsts[k] < 0 && pos < bounds[k+1] && !scanner.terminated()) {
+				std::ptrdiff_t const end = std::min(pos + window, bounds[k+1]);
+
+				next = scanner.scan(data, pos, end, end == length, firsts[k]);
+				if(next == pos)
+					break;
+				pos = next;
+			}
+		});
+
+		std::vector<std::ptrdiff_t> cuts(1, 0);
+		for(std::size_t k=1; k<no_parts; ++k)
+			if(firsts[k] > cuts.back() && firsts[k] < length)
+				cuts.push_back(firsts[k]);
+		cuts.push_back(length);
+
+		return cuts;
+	}
+}
+
+#endif //MINIFY_STREAM_H
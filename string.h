@@ -6,6 +6,7 @@
 #define MINIFY_STRING_H
 
 #include <cstddef>
+#include <cerrno>
 #include <cstdlib>
 #include <cstdio>
 #include <iostream>
@@ -15,40 +16,145 @@
 
 #include <algorithm>
 
+#include "arena.h"
+
+#if !defined _WIN32 && !defined _WIN64 && !defined __EMSCRIPTEN__
+	#define MINIFY_HAS_MMAP 1
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 namespace minify {
 	namespace type {
+		/*
+		 *  non-owning (pointer, length) window onto a string, 
+		 *  compares against literals without copying
+		 */
+		class string_view {
+			char const* data_ = nullptr;
+			std::ptrdiff_t length_ = 0;
+
+			static constexpr bool equal(
+				char const* a,
+				char const* b,
+				std::ptrdiff_t const length
+			) {
+				return !length || (
+					*a == *b &&
+					equal(a+1, b+1, length-1)
+				);
+			}
+
+			public:
+			constexpr string_view() {
+			}
+
+			constexpr string_view(
+				char const* data,
+				std::ptrdiff_t const& length
+			) : data_(data), length_(length) {
+			}
+
+			template <std::size_t N>
+			constexpr string_view(
+				char const (&literal)[N]
+			) : data_(literal), length_(N-1) {
+			}
+
+			constexpr char const* data() const {
+				return data_;
+			}
+
+			constexpr std::ptrdiff_t length() const {
+				return length_;
+			}
+
+			constexpr char operator[](std::ptrdiff_t const& i) const {
+				return data_[i];
+			}
+
+			constexpr bool starts_with(string_view const& prefix) const {
+				return (
+					prefix.length_ <= length_ &&
+					equal(data_, prefix.data_, prefix.length_)
+				);
+			}
+
+			bool contains(string_view const& part) const {
+				for(std::ptrdiff_t i = 0; i + part.length_ <= length_; ++i)
+					if(!memcmp(data_ + i, part.data_, part.length_))
+						return 1;
+
+				return 0;
+			}
+
+			friend constexpr bool operator==(
+				string_view const& view1,
+				string_view const& view2
+			) {
+				return (
+					view1.length_ == view2.length_ &&
+					equal(view1.data_, view2.data_, view1.length_)
+				);
+			}
+
+			friend constexpr bool operator!=(
+				string_view const& view1,
+				string_view const& view2
+			) {
+				return !(view1 == view2);
+			}
+		};
+
 		class string {
 			static constexpr std::size_t CHAR_SIZE = sizeof(char);
 			static constexpr double RESIZE_MULTIPLIER = 1.25;
+			//zeroed bytes readable past the end of a mapped file
+			static constexpr std::ptrdiff_t MAP_PADDING = 64;
 
-			bool allocated_  = 0;
+			bool allocated_  = 0,
+			     mapped_     = 0;
 			std::ptrdiff_t length_   = 0, 
 			               capacity_ = 0;
+			std::size_t mapped_length_ = 0;
 			char* c_str_ = nullptr;
-
-			void resize_capacity(
-				std::ptrdiff_t const& capacity
-			) {
-				capacity_ = RESIZE_MULTIPLIER*capacity + 1;
-			}
+			arena* arena_ = nullptr;
 
 			void allocate(std::ptrdiff_t const& capacity) {
-				assert(!allocated_);
+				assert(!allocated_ && !mapped_);
 				allocated_ = 1;
 				capacity_  = std::max<std::ptrdiff_t>(1, capacity);
-				c_str_ = (char*) malloc(
-					CHAR_SIZE*capacity_
+				c_str_ = (char*) ((arena_) 
+					? arena_->allocate(CHAR_SIZE*capacity_)
+					: malloc(CHAR_SIZE*capacity_)
 				);
 				c_str_[capacity_-1] = '\0';
 			}
 
+			void deallocate() {
+				if(arena_)
+					arena_->deallocate(c_str_, CHAR_SIZE*capacity_);
+				else
+					free(c_str_);
+			}
+
 			void reallocate(std::ptrdiff_t const& capacity) {
-				assert(allocated_);
+				assert(allocated_ && !mapped_);
 				if(capacity_ != capacity) {
+					std::ptrdiff_t const old_capacity = capacity_;
 					capacity_ = std::max<std::ptrdiff_t>(1, capacity);
-					c_str_ = (char*) realloc(
-						c_str_, 
-						CHAR_SIZE*capacity_
+					c_str_ = (char*) ((arena_)
+						? arena_->reallocate(
+							c_str_, 
+							CHAR_SIZE*old_capacity, 
+							CHAR_SIZE*capacity_
+						)
+						: realloc(
+							c_str_, 
+							CHAR_SIZE*capacity_
+						)
 					);
 					c_str_[capacity_-1] = '\0';
 				}
@@ -58,6 +164,12 @@ namespace minify {
 			string() {
 			}
 
+			//draws all storage from pool, drop() before pool is reset
+			explicit string(
+				arena& pool
+			) : arena_(&pool) {
+			}
+
 			string(
 				std::ptrdiff_t const& capacity
 			) {
@@ -82,15 +194,18 @@ namespace minify {
 				std::ptrdiff_t const& pos,
 				std::ptrdiff_t const& length
 			) {
-				assert(str.allocated());
-				length_ = length;
+				assert(str.allocated() || str.mapped());
+				length_ = std::max<std::ptrdiff_t>(
+					0, 
+					std::min(length, str.length() - pos)
+				);
 				if(capacity_ <= length_)
 					strict_resize(length_+1);
 
 				memcpy(
 					c_str_,
 					&str[pos],
-					length
+					length_
 				);
 				c_str_[length_] = '\0';
 
@@ -102,7 +217,7 @@ namespace minify {
 				std::ptrdiff_t const& pos,
 				std::ptrdiff_t const& length
 			) {
-				assert(str.allocated());
+				assert(str.allocated() || str.mapped());
 				if(capacity_ <= length_ + length)
 					strict_resize(length_ + length + 1);
 
@@ -115,22 +230,112 @@ namespace minify {
 				c_str_[length_] = '\0';
 			}
 
+			void append(
+				char const* data,
+				std::ptrdiff_t const& length
+			) {
+				smart_resize(length_ + length + 1);
+
+				memcpy(
+					&c_str_[length_],
+					data,
+					length
+				);
+				length_ += length;
+				c_str_[length_] = '\0';
+			}
+
+			//appends up to length bytes read from f, returns the number read
+			std::ptrdiff_t append(
+				FILE* f,
+				std::ptrdiff_t const& length
+			) {
+				smart_resize(length_ + length + 1);
+
+				std::ptrdiff_t const read = fread(
+					&c_str_[length_],
+					CHAR_SIZE,
+					length,
+					f
+				);
+				length_ += read;
+				c_str_[length_] = '\0';
+
+				return read;
+			}
+
+			/*
+			 *  as append(f, length) but returns as soon as f has anything,
+			 *  so a pipe is not held up waiting for a whole block. returns
+			 *  0 only at the end of f (or on an error)
+			 */
+			std::ptrdiff_t append_available(
+				FILE* f,
+				std::ptrdiff_t const& length
+			) {
+				#ifdef MINIFY_HAS_MMAP
+					smart_resize(length_ + length + 1);
+
+					ssize_t read;
+					while(
+						(read = ::read(fileno(f), &c_str_[length_], length)) < 0 &&
+						errno == EINTR
+					);
+
+					if(read < 0)
+						read = 0;
+					length_ += read;
+					c_str_[length_] = '\0';
+
+					return read;
+				#else
+					return append(f, length);
+				#endif
+			}
+
+			//drops the first length characters, moving the rest forward
+			void erase_front(
+				std::ptrdiff_t const& length
+			) {
+				memmove(
+					c_str_,
+					&c_str_[length],
+					length_ - length
+				);
+				length_ -= length;
+				c_str_[length_] = '\0';
+			}
+
+			void unmap() {
+				#ifdef MINIFY_HAS_MMAP
+					munmap(c_str_, mapped_length_);
+				#endif
+				c_str_ = nullptr;
+				mapped_ = 0;
+				mapped_length_ = 0;
+				length_ = capacity_ = 0;
+			}
+
 			~string() {
 				if(allocated_)
 				{
+					deallocate();
 					allocated_ = 0;
 					length_ = capacity_ = 0;
-					free(c_str_);
 				}
+				else if(mapped_)
+					unmap();
 			}
 
 			void drop() {
 				if(allocated_)
 				{
-					free(c_str_);
+					deallocate();
 					allocated_ = 0;
 					length_ = capacity_ = 0;
 				}
+				else if(mapped_)
+					unmap();
 			}
 
 			void strict_resize(
@@ -151,10 +356,8 @@ namespace minify {
 					if(capacity)
 						allocate(capacity);
 				}
-				else if(capacity_ != capacity) {
-					resize_capacity(capacity);
-					reallocate(capacity);
-				}
+				else if(capacity_ < capacity)
+					reallocate(RESIZE_MULTIPLIER*capacity + 1);
 			}
 
 			void save(char const* path) {
@@ -204,6 +407,78 @@ namespace minify {
 				fclose(f);
 			}
 
+			/*
+			 *  maps path read-only in place of reading it into the heap,
+			 *  the mapping is followed by at least MAP_PADDING zeroed 
+			 *  bytes so c_str() stays null terminated. returns 0, leaving 
+			 *  the string untouched, if the file is smaller than min_length
+			 *  or can not be mapped (the caller should fall back to load_file)
+			 */
+			bool map_file(
+				char const* path,
+				std::ptrdiff_t const& min_length = 0
+			) {
+				#ifdef MINIFY_HAS_MMAP
+					int fd = open(path, O_RDONLY);
+					if(fd < 0)
+						return 0;
+
+					struct stat info;
+					if(
+						fstat(fd, &info) != 0 ||
+						!info.st_size ||
+						info.st_size < min_length
+					) {
+						close(fd);
+						return 0;
+					}
+
+					std::size_t const page = sysconf(_SC_PAGESIZE),
+					                  length = info.st_size,
+					                  region_length = 
+					                  	(length + MAP_PADDING + page - 1)/page*page;
+
+					//reserve zeroed pages for the padding, then map the file over them
+					void* region = mmap(
+						nullptr, 
+						region_length, 
+						PROT_READ, 
+						MAP_PRIVATE | MAP_ANONYMOUS, 
+						-1, 
+						0
+					);
+					if(region == MAP_FAILED) {
+						close(fd);
+						return 0;
+					}
+
+					int flags = MAP_PRIVATE | MAP_FIXED;
+					#ifdef MAP_POPULATE
+						flags |= MAP_POPULATE;
+					#endif
+					if(mmap(region, length, PROT_READ, flags, fd, 0) == MAP_FAILED) {
+						munmap(region, region_length);
+						close(fd);
+						return 0;
+					}
+					close(fd);
+					madvise(region, length, MADV_SEQUENTIAL);
+
+					drop();
+					mapped_ = 1;
+					mapped_length_ = region_length;
+					c_str_ = (char*) region;
+					length_ = length;
+					capacity_ = length_ + 1;
+
+					return 1;
+				#else
+					(void) path;
+					(void) min_length;
+					return 0;
+				#endif
+			}
+
 			void set(string const& cstr) {
 				strict_resize(cstr.capacity());
 				length_ = cstr.length();
@@ -274,6 +549,22 @@ namespace minify {
 				return c_str_;
 			}
 
+			//window of up to length chars from pos, clipped to the string
+			string_view view(
+				std::ptrdiff_t const& pos,
+				std::ptrdiff_t const& length
+			) const {
+				std::ptrdiff_t const begin = std::min(
+					std::max<std::ptrdiff_t>(0, pos), 
+					length_
+				);
+
+				return string_view(
+					c_str_ + begin,
+					std::min(length, length_ - begin)
+				);
+			}
+
 			std::ptrdiff_t const& length() const {
 				return length_;
 			}
@@ -299,6 +590,10 @@ namespace minify {
 				return allocated_;
 			}
 
+			bool const& mapped() const {
+				return mapped_;
+			}
+
 			std::ptrdiff_t const& capacity() const {
 				return capacity_;
 			}
@@ -429,7 +724,7 @@ namespace minify {
 				string const& cstr
 			) {
 				if(
-					cstr.allocated_ &&
+					(cstr.allocated_ || cstr.mapped_) &&
 					cstr.capacity_  &&
 					cstr.length_
 				)
@@ -0,0 +1,419 @@
+/**
+ *  batched file io through linux's io_uring
+ *
+ *  minifying many small files is bound by the syscalls around them (stat,
+ *  open, seek, read and close to load each, open, write and close to save
+ *  it) more than by the minifying. a uring queues those for a whole batch
+ *  of files and has the kernel do them in a handful of io_uring_enter
+ *  calls. the ring is driven through the raw syscalls so there is nothing
+ *  to link against, and everything here reports what it could not do so
+ *  the caller can fall back to the blocking calls (a kernel without
+ *  io_uring, or with it disabled, just never has a ready ring)
+ */
+
+#ifndef MINIFY_URING_H
+#define MINIFY_URING_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "string.h"
+
+#if defined __linux__ && defined __has_include
+	#if __has_include(<linux/io_uring.h>)
+		#include <fcntl.h>
+		#include <linux/io_uring.h>
+		//linux/fs.h (through io_uring.h) defines these as macros
+		#undef BLOCK_SIZE
+		#undef BLOCK_SIZE_BITS
+		#include <sys/mman.h>
+		#include <sys/stat.h>
+		#include <sys/syscall.h>
+		#include <unistd.h>
+
+		#if defined __NR_io_uring_setup && defined STATX_SIZE
+			#define MINIFY_HAS_URING
+		#endif
+	#endif
+#endif
+
+namespace minify {
+	#ifdef MINIFY_HAS_URING
+		class uring {
+			int fd_ = -1;
+			unsigned entries_ = 0;
+			void* sq_ptr_ = nullptr;
+			void* cq_ptr_ = nullptr;
+			std::size_t sq_size_ = 0,
+			            cq_size_ = 0;
+			io_uring_sqe* sqes_ = nullptr;
+			unsigned *sq_head_, *sq_tail_, *sq_mask_, *sq_array_,
+			         *cq_head_, *cq_tail_, *cq_mask_;
+			io_uring_cqe* cqes_ = nullptr;
+			unsigned queued_ = 0;
+
+			//whether the kernel knows every op the batches below use
+			bool supports_ops() {
+				std::size_t const size = sizeof(io_uring_probe) + 256*sizeof(io_uring_probe_op);
+				std::vector<unsigned long long> storage(size/sizeof(unsigned long long) + 1, 0);
+				io_uring_probe* probe = (io_uring_probe*) &storage[0];
+
+				if(syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0)
+					return 0;
+
+				unsigned char const ops[] = {
+					IORING_OP_OPENAT,
+					IORING_OP_STATX,
+					IORING_OP_READ,
+					IORING_OP_WRITE,
+					IORING_OP_CLOSE
+				};
+				for(unsigned char const op : ops)
+					if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+						return 0;
+
+				return 1;
+			}
+
+			void release() {
+				if(sqes_)
+					munmap(sqes_, entries_*sizeof(io_uring_sqe));
+				if(cq_ptr_ && cq_ptr_ != sq_ptr_)
+					munmap(cq_ptr_, cq_size_);
+				if(sq_ptr_)
+					munmap(sq_ptr_, sq_size_);
+				if(fd_ >= 0)
+					::close(fd_);
+
+				fd_ = -1;
+				sq_ptr_ = cq_ptr_ = nullptr;
+				sqes_ = nullptr;
+			}
+
+			public:
+			//a ring with room for entries requests, not ready if there can be none
+			explicit uring(unsigned const& entries = 64) {
+				io_uring_params params;
+				memset(&params, 0, sizeof(params));
+
+				fd_ = syscall(__NR_io_uring_setup, entries, &params);
+				if(fd_ < 0)
+					return;
+				entries_ = params.sq_entries;
+
+				sq_size_ = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+				cq_size_ = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+				if(params.features & IORING_FEAT_SINGLE_MMAP)
+					sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+				sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+				if(sq_ptr_ == MAP_FAILED) {
+					sq_ptr_ = nullptr;
+					release();
+					return;
+				}
+
+				cq_ptr_ = (params.features & IORING_FEAT_SINGLE_MMAP)
+					? sq_ptr_
+					: mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+				if(cq_ptr_ == MAP_FAILED) {
+					cq_ptr_ = nullptr;
+					release();
+					return;
+				}
+
+				void* sqes = mmap(nullptr, entries_*sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+				if(sqes == MAP_FAILED) {
+					release();
+					return;
+				}
+				sqes_ = (io_uring_sqe*) sqes;
+
+				char* const sq = (char*) sq_ptr_;
+				char* const cq = (char*) cq_ptr_;
+				sq_head_  = (unsigned*) (sq + params.sq_off.head);
+				sq_tail_  = (unsigned*) (sq + params.sq_off.tail);
+				sq_mask_  = (unsigned*) (sq + params.sq_off.ring_mask);
+				sq_array_ = (unsigned*) (sq + params.sq_off.array);
+				cq_head_  = (unsigned*) (cq + params.cq_off.head);
+				cq_tail_  = (unsigned*) (cq + params.cq_off.tail);
+				cq_mask_  = (unsigned*) (cq + params.cq_off.ring_mask);
+				cqes_     = (io_uring_cqe*) (cq + params.cq_off.cqes);
+
+				if(!supports_ops())
+					release();
+			}
+
+			uring(uring const&) = delete;
+			uring& operator=(uring const&) = delete;
+
+			~uring() {
+				release();
+			}
+
+			bool ready() const {
+				return fd_ >= 0;
+			}
+
+			//the most requests that can be queued before a submit
+			unsigned const& capacity() const {
+				return entries_;
+			}
+
+			//the next request to fill in (zeroed), at most capacity between submits
+			io_uring_sqe* queue() {
+				unsigned const tail  = *sq_tail_ + queued_,
+				               index = tail & *sq_mask_;
+				io_uring_sqe* sqe = &sqes_[index];
+
+				memset(sqe, 0, sizeof(*sqe));
+				sq_array_[index] = index;
+				++queued_;
+
+				return sqe;
+			}
+
+			/*
+			 *  hands the queued requests to the kernel and waits for them all,
+			 *  calling done(user_data, result) for each. 0 if the ring failed
+			 */
+			template <class Done>
+			bool complete(Done done) {
+				unsigned const submitted = queued_;
+
+				__atomic_store_n(sq_tail_, *sq_tail_ + queued_, __ATOMIC_RELEASE);
+				queued_ = 0;
+
+				for(unsigned reaped = 0; reaped < submitted;) {
+					unsigned head = *cq_head_;
+
+					if(head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+						//submits anything not yet taken and waits for a completion
+						unsigned const pending = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+						if(
+							syscall(__NR_io_uring_enter, fd_, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+							errno != EINTR && errno != EAGAIN && errno != EBUSY
+						)
+							return 0;
+						continue;
+					}
+
+					for(; head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE); ++head, ++reaped) {
+						io_uring_cqe const& cqe = cqes_[head & *cq_mask_];
+						done(cqe.user_data, cqe.res);
+					}
+					__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+				}
+
+				return 1;
+			}
+		};
+
+		/*
+		 *  reads the files at paths into texts, each stat'd, opened, read
+		 *  and closed by the ring. a text is left nullptr where that failed
+		 *  for any reason, for the caller to retry the blocking way
+		 */
+		inline void uring_read_files(
+			uring& ring,
+			std::vector<char const*> const& paths,
+			std::vector<std::unique_ptr<minify::type::string> >& texts
+		) {
+			texts.clear();
+			texts.resize(paths.size());
+
+			//two requests a file per submit
+			std::size_t const chunk = ring.capacity() / 2;
+			std::vector<struct statx> stats(chunk);
+			std::vector<int> fds(chunk),
+			                 reads(chunk);
+
+			for(std::size_t first=0; first<paths.size(); first+=chunk) {
+				std::size_t const last = std::min(paths.size(), first + chunk);
+
+				//opens each file and stats it alongside
+				for(std::size_t f=first; f<last; ++f) {
+					io_uring_sqe* open = ring.queue();
+					open->opcode    = IORING_OP_OPENAT;
+					open->fd        = AT_FDCWD;
+					open->addr      = (unsigned long long) paths[f];
+					open->open_flags = O_RDONLY | O_CLOEXEC;
+					open->user_data = 2*(f - first);
+
+					io_uring_sqe* stat = ring.queue();
+					stat->opcode    = IORING_OP_STATX;
+					stat->fd        = AT_FDCWD;
+					stat->addr      = (unsigned long long) paths[f];
+					stat->len       = STATX_SIZE | STATX_TYPE;
+					stat->off       = (unsigned long long) &stats[f - first];
+					stat->user_data = 2*(f - first) + 1;
+				}
+
+				std::vector<int> stat_results(last - first, -1);
+				bool const opened = ring.complete([&](unsigned long long const& id, int const& res) {
+					if(id % 2)
+						stat_results[id/2] = res;
+					else
+						fds[id/2] = res;
+				});
+				if(!opened)
+					return;
+
+				//reads each regular file whole, then closes it whatever the read did
+				for(std::size_t f=first; f<last; ++f) {
+					int const& fd = fds[f - first];
+					if(fd < 0)
+						continue;
+
+					struct statx const& info = stats[f - first];
+					if(!stat_results[f - first] && S_ISREG(info.stx_mode) && info.stx_size < (1u << 30)) {
+						texts[f].reset(new minify::type::string());
+						texts[f]->strict_resize(int(info.stx_size) + 1);
+
+						io_uring_sqe* read = ring.queue();
+						read->opcode    = IORING_OP_READ;
+						read->fd        = fd;
+						read->addr      = (unsigned long long) &(*texts[f])[0];
+						read->len       = info.stx_size;
+						read->off       = 0;
+						read->flags     = IOSQE_IO_HARDLINK;
+						read->user_data = 2*(f - first);
+						reads[f - first] = -1;
+					}
+
+					io_uring_sqe* close = ring.queue();
+					close->opcode    = IORING_OP_CLOSE;
+					close->fd        = fd;
+					close->user_data = 2*(f - first) + 1;
+				}
+
+				bool const read = ring.complete([&](unsigned long long const& id, int const& res) {
+					if(id % 2) {
+						//a close that never ran, the descriptor is still open
+						if(res == -ECANCELED)
+							::close(fds[id/2]);
+					}
+					else
+						reads[id/2] = res;
+				});
+
+				for(std::size_t f=first; f<last; ++f)
+					if(texts[f]) {
+						//short reads (the file changed under us) go the blocking way too
+						if(!read || reads[f - first] != (int) stats[f - first].stx_size)
+							texts[f].reset();
+						else {
+							(*texts[f])[reads[f - first]] = '\0';
+							texts[f]->length(reads[f - first]);
+						}
+					}
+			}
+		}
+
+		/*
+		 *  writes texts out to paths (created or truncated), written[f] is
+		 *  left 0 where that failed for the caller to retry the blocking way
+		 */
+		inline void uring_write_files(
+			uring& ring,
+			std::vector<char const*> const& paths,
+			std::vector<minify::type::string const*> const& texts,
+			std::vector<bool>& written
+		) {
+			written.assign(paths.size(), 0);
+
+			std::size_t const chunk = ring.capacity() / 2;
+			std::vector<int> fds(chunk),
+			                 writes(chunk);
+
+			for(std::size_t first=0; first<paths.size(); first+=chunk) {
+				std::size_t const last = std::min(paths.size(), first + chunk);
+
+				for(std::size_t f=first; f<last; ++f) {
+					io_uring_sqe* open = ring.queue();
+					open->opcode     = IORING_OP_OPENAT;
+					open->fd         = AT_FDCWD;
+					open->addr       = (unsigned long long) paths[f];
+					open->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+					open->len        = 0644;
+					open->user_data  = f - first;
+				}
+
+				if(!ring.complete([&](unsigned long long const& id, int const& res) { fds[id] = res; }))
+					return;
+
+				for(std::size_t f=first; f<last; ++f) {
+					int const& fd = fds[f - first];
+					if(fd < 0)
+						continue;
+
+					writes[f - first] = -1;
+					if(texts[f]->length()) {
+						io_uring_sqe* write = ring.queue();
+						write->opcode    = IORING_OP_WRITE;
+						write->fd        = fd;
+						write->addr      = (unsigned long long) &(*texts[f])[0];
+						write->len       = texts[f]->length();
+						write->off       = 0;
+						write->flags     = IOSQE_IO_HARDLINK;
+						write->user_data = 2*(f - first);
+					}
+					else
+						writes[f - first] = 0;
+
+					io_uring_sqe* close = ring.queue();
+					close->opcode    = IORING_OP_CLOSE;
+					close->fd        = fd;
+					close->user_data = 2*(f - first) + 1;
+				}
+
+				bool const done = ring.complete([&](unsigned long long const& id, int const& res) {
+					if(id % 2) {
+						//a close that never ran, the descriptor is still open
+						if(res == -ECANCELED)
+							::close(fds[id/2]);
+					}
+					else
+						writes[id/2] = res;
+				});
+
+				for(std::size_t f=first; f<last; ++f)
+					written[f] = done && fds[f - first] >= 0 && writes[f - first] == texts[f]->length();
+			}
+		}
+	#else
+		//without io_uring there is never a ready ring, callers take the blocking path
+		class uring {
+			public:
+			explicit uring(unsigned const& = 64) {}
+
+			bool ready() const {
+				return 0;
+			}
+		};
+
+		inline void uring_read_files(
+			uring&,
+			std::vector<char const*> const& paths,
+			std::vector<std::unique_ptr<minify::type::string> >& texts
+		) {
+			texts.clear();
+			texts.resize(paths.size());
+		}
+
+		inline void uring_write_files(
+			uring&,
+			std::vector<char const*> const& paths,
+			std::vector<minify::type::string const*> const&,
+			std::vector<bool>& written
+		) {
+			written.assign(paths.size(), 0);
+		}
+	#endif
+}
+
+#endif //MINIFY_URING_H
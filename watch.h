@@ -0,0 +1,128 @@
+/**
+ *  waits for the inputs to change (--watch), through linux's inotify
+ *
+ *  editors often save by writing a new file and renaming it over the old
+ *  one, which ends any watch on the file itself, so it is the directories
+ *  holding the inputs that are watched, for files closed after writing or
+ *  moved in. a save tends to come as a burst of events, so wait only
+ *  returns once the burst has been quiet for a few milliseconds
+ */
+
+#ifndef MINIFY_WATCH_H
+#define MINIFY_WATCH_H
+
+#include <cerrno>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+	#include <poll.h>
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+namespace minify {
+	class watcher {
+		int fd_ = -1;
+		//(watch, file name) to the inputs at that path
+		std::map<std::pair<int, std::string>, std::vector<std::size_t> > inputs_;
+
+		public:
+		explicit watcher(std::vector<char const*> const& paths) {
+			#ifdef __linux__
+				fd_ = inotify_init1(IN_CLOEXEC);
+				if(fd_ < 0)
+					return;
+
+				for(std::size_t i=0; i<paths.size(); ++i) {
+					std::string const path = paths[i];
+					std::size_t const slash = path.rfind('/');
+					std::string const dir  = (slash == std::string::npos) ? "." : path.substr(0, slash + 1),
+					                  name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+					//the same directory gives back the same watch
+					int const wd = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+					if(wd >= 0)
+						inputs_[std::make_pair(wd, name)].push_back(i);
+				}
+			#else
+				(void) paths;
+			#endif
+		}
+
+		watcher(watcher const&) = delete;
+		watcher& operator=(watcher const&) = delete;
+
+		~watcher() {
+			#ifdef __linux__
+				if(fd_ >= 0)
+					close(fd_);
+			#endif
+		}
+
+		//0 where inotify is not available
+		bool ready() const {
+			return fd_ >= 0;
+		}
+
+		/*
+		 *  blocks until at least one input has changed and no event has
+		 *  come for quiet_ms since, then gives the inputs that changed (in
+		 *  input order). returns 0 if the watch failed
+		 */
+		bool wait(
+			std::vector<std::size_t>& changed,
+			int const& quiet_ms
+		) {
+			changed.clear();
+
+			#ifdef __linux__
+				std::set<std::size_t> inputs;
+				alignas(inotify_event) char buffer[1 << 14];
+
+				while(fd_ >= 0) {
+					pollfd poll_fd = { fd_, POLLIN, 0 };
+					int const ready = poll(&poll_fd, 1, (inputs.empty()) ? -1 : quiet_ms);
+
+					if(ready < 0) {
+						if(errno == EINTR)
+							continue;
+						return 0;
+					}
+					if(!ready)
+						break; //quiet since the last event
+
+					ssize_t const got = read(fd_, buffer, sizeof(buffer));
+					if(got <= 0)
+						return 0;
+
+					for(char* e = buffer; e < buffer + got;) {
+						inotify_event const* event = (inotify_event const*) e;
+
+						if(event->len) {
+							std::map<std::pair<int, std::string>, std::vector<std::size_t> >::const_iterator
+								watched = inputs_.find(std::make_pair(event->wd, std::string(event->name)));
+
+							if(watched != inputs_.end())
+								inputs.insert(watched->second.begin(), watched->second.end());
+						}
+
+						e += sizeof(inotify_event) + event->len;
+					}
+				}
+
+				changed.assign(inputs.begin(), inputs.end());
+				return fd_ >= 0;
+			#else
+				(void) quiet_ms;
+				return 0;
+			#endif
+		}
+	};
+}
+
+#endif //MINIFY_WATCH_H